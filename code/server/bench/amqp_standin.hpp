@@ -0,0 +1,700 @@
+#pragma once
+#include <ev.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <deque>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <thread>
+#include "../common/logger.hpp"
+
+// 进程内 AMQP 0-9-1 替身服务器，用于在没有 RabbitMQ 的环境下压测 MQClient
+// 只实现 MQClient 用到的子集：连接握手、信道开关、交换机/队列声明与绑定、
+// basic.qos/consume/cancel/publish/deliver/ack/reject/nack、发布确认(confirm.select)以及心跳
+// 交换机只区分 fanout 与其他类型(按 direct 精确匹配路由键)，消息不持久化
+namespace hmy{
+class AMQPStandin
+{
+public:
+    // port 为 0 时由系统分配端口，通过 port() 获取
+    AMQPStandin(uint16_t port = 0)
+    : _loop(ev_loop_new(0)), _listen_fd(-1), _port(port), _queue_seq(0), _tag_seq(0)
+    {
+        _listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int opt = 1;
+        setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(bind(_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(_listen_fd, 128) < 0)
+        {
+            LOG_ERROR("AMQP 替身服务器监听端口 {} 失败: {}", port, strerror(errno));
+            abort();
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(_listen_fd, (struct sockaddr*)&addr, &len);
+        _port = ntohs(addr.sin_port);
+        fcntl(_listen_fd, F_SETFL, fcntl(_listen_fd, F_GETFL) | O_NONBLOCK);
+
+        ev_io_init(&_accept_watcher, accept_callback, _listen_fd, EV_READ);
+        _accept_watcher.data = this;
+        ev_io_start(_loop, &_accept_watcher);
+        ev_async_init(&_stop_watcher, stop_callback);
+        ev_async_start(_loop, &_stop_watcher);
+        ev_timer_init(&_heartbeat_timer, heartbeat_callback, 1, 1);
+        _heartbeat_timer.data = this;
+        ev_timer_start(_loop, &_heartbeat_timer);
+        _loop_thread = std::thread([this](){
+            ev_run(_loop, 0);
+        });
+    }
+
+    ~AMQPStandin()
+    {
+        ev_async_send(_loop, &_stop_watcher);
+        _loop_thread.join();
+        while(!_connections.empty())
+            destroy(_connections.begin()->second.get());
+        ev_io_stop(_loop, &_accept_watcher);
+        ev_async_stop(_loop, &_stop_watcher);
+        ev_timer_stop(_loop, &_heartbeat_timer);
+        close(_listen_fd);
+        ev_loop_destroy(_loop);
+    }
+
+    uint16_t port() const
+    {
+        return _port;
+    }
+private:
+    static constexpr uint8_t FRAME_METHOD = 1;
+    static constexpr uint8_t FRAME_HEADER = 2;
+    static constexpr uint8_t FRAME_BODY = 3;
+    static constexpr uint8_t FRAME_HEARTBEAT = 8;
+    static constexpr uint8_t FRAME_END = 0xCE;
+    static constexpr uint32_t FRAME_MAX = 131072;
+
+    // 按网络字节序读取帧负载
+    class Reader
+    {
+    public:
+        Reader(const std::string& data) : _data(data), _pos(0) {}
+        uint8_t octet() { return _pos < _data.size() ? (uint8_t)_data[_pos++] : 0; }
+        uint16_t shortint() { uint16_t v = octet(); return (v << 8) | octet(); }
+        uint32_t longint() { uint32_t v = shortint(); return (v << 16) | shortint(); }
+        uint64_t longlong() { uint64_t v = longint(); return (v << 32) | longint(); }
+        std::string shortstr() { return bytes(octet()); }
+        std::string longstr() { return bytes(longint()); }
+        void table() { bytes(longint()); }
+        std::string rest() { return bytes(_data.size() - _pos); }
+    private:
+        std::string bytes(size_t n)
+        {
+            n = std::min(n, _data.size() - _pos);
+            std::string s = _data.substr(_pos, n);
+            _pos += n;
+            return s;
+        }
+    private:
+        const std::string& _data;
+        size_t _pos;
+    };
+
+    // 按网络字节序构造帧负载
+    class Writer
+    {
+    public:
+        Writer& octet(uint8_t v) { _data.push_back((char)v); return *this; }
+        Writer& shortint(uint16_t v) { return octet(v >> 8).octet(v & 0xFF); }
+        Writer& longint(uint32_t v) { return shortint(v >> 16).shortint(v & 0xFFFF); }
+        Writer& longlong(uint64_t v) { return longint(v >> 32).longint(v & 0xFFFFFFFF); }
+        Writer& shortstr(const std::string& s) { octet(s.size()); _data.append(s); return *this; }
+        Writer& longstr(const std::string& s) { longint(s.size()); _data.append(s); return *this; }
+        Writer& table() { return longint(0); }
+        Writer& raw(const std::string& s) { _data.append(s); return *this; }
+        const std::string& data() const { return _data; }
+    private:
+        std::string _data;
+    };
+
+    struct Message
+    {
+        std::string exchange;
+        std::string routing_key;
+        std::string properties; // 内容头帧中 body-size 之后的属性部分，原样转发给消费者
+        std::string body;
+        uint64_t body_size;
+        bool redelivered;
+    };
+    struct Connection;
+    struct Consumer
+    {
+        Connection* conn;
+        uint16_t channel;
+        std::string tag;
+        std::string queue;
+        uint16_t prefetch; // 0 表示不限制
+        uint32_t unacked;
+        bool no_ack;
+    };
+    struct Queue
+    {
+        std::deque<Message> messages;
+        std::vector<std::shared_ptr<Consumer>> consumers;
+        size_t cursor = 0; // 消费者轮转下标
+    };
+    struct Unacked
+    {
+        Message message;
+        std::shared_ptr<Consumer> consumer;
+    };
+    struct Channel
+    {
+        uint16_t prefetch = 0;
+        uint64_t next_tag = 1;
+        std::map<uint64_t, Unacked> unacked; // 投递标签 -> 未确认的消息
+        bool publishing = false; // 是否正在接收 basic.publish 的内容帧
+        Message pending;
+        bool confirm = false; // 是否处于发布确认模式
+        uint64_t published = 0; // 确认模式下已接收的消息数，即最近一条消息的投递标签
+    };
+    struct Connection
+    {
+        AMQPStandin* server;
+        int fd;
+        ev_io read_watcher;
+        ev_io write_watcher;
+        bool writing = false;
+        bool handshake = false;
+        bool closed = false;
+        uint32_t frame_max = FRAME_MAX;
+        uint16_t heartbeat = 0;
+        std::string in;
+        std::string out;
+        std::unordered_map<uint16_t, Channel> channels;
+    };
+
+    static void accept_callback(struct ev_loop* loop, ev_io* watcher, int32_t revents)
+    {
+        AMQPStandin* server = static_cast<AMQPStandin*>(watcher->data);
+        while(true)
+        {
+            int fd = accept(server->_listen_fd, nullptr, nullptr);
+            if(fd < 0)
+                break;
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            int opt = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+            auto conn = std::make_unique<Connection>();
+            conn->server = server;
+            conn->fd = fd;
+            ev_io_init(&conn->read_watcher, read_callback, fd, EV_READ);
+            conn->read_watcher.data = conn.get();
+            ev_io_init(&conn->write_watcher, write_callback, fd, EV_WRITE);
+            conn->write_watcher.data = conn.get();
+            ev_io_start(loop, &conn->read_watcher);
+            server->_connections[fd] = std::move(conn);
+        }
+    }
+
+    static void read_callback(struct ev_loop* loop, ev_io* watcher, int32_t revents)
+    {
+        Connection* conn = static_cast<Connection*>(watcher->data);
+        AMQPStandin* server = conn->server;
+        char buf[65536];
+        ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+        if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+        {
+            server->destroy(conn);
+            return;
+        }
+        if(n > 0)
+        {
+            conn->in.append(buf, n);
+            server->process(conn);
+        }
+        if(conn->closed)
+            server->destroy(conn);
+    }
+
+    static void write_callback(struct ev_loop* loop, ev_io* watcher, int32_t revents)
+    {
+        Connection* conn = static_cast<Connection*>(watcher->data);
+        conn->server->flush(conn);
+        if(conn->closed && conn->out.empty())
+            conn->server->destroy(conn);
+    }
+
+    static void stop_callback(struct ev_loop* loop, ev_async* watcher, int32_t revents)
+    {
+        ev_break(loop, EVBREAK_ALL);
+    }
+
+    static void heartbeat_callback(struct ev_loop* loop, ev_timer* watcher, int32_t revents)
+    {
+        AMQPStandin* server = static_cast<AMQPStandin*>(watcher->data);
+        for(auto& it : server->_connections)
+        {
+            if(it.second->heartbeat > 0)
+                server->sendFrame(it.second.get(), FRAME_HEARTBEAT, 0, std::string());
+        }
+    }
+
+    // 解析输入缓冲区中所有完整的帧
+    void process(Connection* conn)
+    {
+        if(!conn->handshake)
+        {
+            if(conn->in.size() < 8)
+                return;
+            if(conn->in.compare(0, 4, "AMQP") != 0)
+            {
+                conn->closed = true;
+                return;
+            }
+            conn->in.erase(0, 8);
+            conn->handshake = true;
+            Writer start;
+            start.octet(0).octet(9).table().longstr("PLAIN").longstr("en_US");
+            sendMethod(conn, 0, 10, 10, start);
+        }
+        size_t pos = 0;
+        while(!conn->closed && conn->in.size() - pos >= 7)
+        {
+            const uint8_t* p = (const uint8_t*)conn->in.data() + pos;
+            uint8_t type = p[0];
+            uint16_t channel = (p[1] << 8) | p[2];
+            uint32_t size = ((uint32_t)p[3] << 24) | (p[4] << 16) | (p[5] << 8) | p[6];
+            if(conn->in.size() - pos < 8 + (size_t)size)
+                break;
+            if(p[7 + size] != FRAME_END)
+            {
+                LOG_ERROR("AMQP 替身服务器收到格式错误的帧");
+                conn->closed = true;
+                break;
+            }
+            std::string payload = conn->in.substr(pos + 7, size);
+            pos += 8 + size;
+            if(type == FRAME_METHOD)
+                onMethod(conn, channel, payload);
+            else if(type == FRAME_HEADER)
+                onHeader(conn, channel, payload);
+            else if(type == FRAME_BODY)
+                onBody(conn, channel, payload);
+        }
+        conn->in.erase(0, pos);
+    }
+
+    void onMethod(Connection* conn, uint16_t channel, const std::string& payload)
+    {
+        Reader reader(payload);
+        uint16_t class_id = reader.shortint();
+        uint16_t method_id = reader.shortint();
+        uint32_t id = ((uint32_t)class_id << 16) | method_id;
+        switch(id)
+        {
+        case (10 << 16) | 11: // connection.start-ok
+        {
+            Writer tune;
+            tune.shortint(2047).longint(FRAME_MAX).shortint(0);
+            sendMethod(conn, 0, 10, 30, tune);
+            break;
+        }
+        case (10 << 16) | 31: // connection.tune-ok
+        {
+            reader.shortint();
+            uint32_t frame_max = reader.longint();
+            if(frame_max > 0)
+                conn->frame_max = std::min(frame_max, FRAME_MAX);
+            conn->heartbeat = reader.shortint();
+            break;
+        }
+        case (10 << 16) | 40: // connection.open
+            sendMethod(conn, 0, 10, 41, Writer().shortstr(""));
+            break;
+        case (10 << 16) | 50: // connection.close
+            sendMethod(conn, 0, 10, 51, Writer());
+            conn->closed = true;
+            break;
+        case (10 << 16) | 51: // connection.close-ok
+            conn->closed = true;
+            break;
+        case (20 << 16) | 10: // channel.open
+            conn->channels[channel] = Channel();
+            sendMethod(conn, channel, 20, 11, Writer().longstr(""));
+            break;
+        case (20 << 16) | 40: // channel.close
+            closeChannel(conn, channel);
+            sendMethod(conn, channel, 20, 41, Writer());
+            break;
+        case (20 << 16) | 41: // channel.close-ok
+            closeChannel(conn, channel);
+            break;
+        case (40 << 16) | 10: // exchange.declare
+        {
+            reader.shortint();
+            std::string exchange = reader.shortstr();
+            std::string type = reader.shortstr();
+            uint8_t bits = reader.octet();
+            _exchanges[exchange] = type;
+            if(!(bits & 0x10))
+                sendMethod(conn, channel, 40, 11, Writer());
+            break;
+        }
+        case (50 << 16) | 10: // queue.declare
+        {
+            reader.shortint();
+            std::string name = reader.shortstr();
+            uint8_t bits = reader.octet();
+            if(name.empty())
+                name = "amq.gen-" + std::to_string(++_queue_seq);
+            Queue& queue = _queues[name];
+            if(!(bits & 0x10))
+                sendMethod(conn, channel, 50, 11, Writer().shortstr(name).longint(queue.messages.size()).longint(queue.consumers.size()));
+            break;
+        }
+        case (50 << 16) | 20: // queue.bind
+        {
+            reader.shortint();
+            std::string queue = reader.shortstr();
+            std::string exchange = reader.shortstr();
+            std::string routing_key = reader.shortstr();
+            uint8_t bits = reader.octet();
+            _bindings[exchange].insert(std::make_pair(routing_key, queue));
+            if(!(bits & 0x01))
+                sendMethod(conn, channel, 50, 21, Writer());
+            break;
+        }
+        case (60 << 16) | 10: // basic.qos
+            reader.longint();
+            conn->channels[channel].prefetch = reader.shortint();
+            sendMethod(conn, channel, 60, 11, Writer());
+            break;
+        case (60 << 16) | 20: // basic.consume
+        {
+            reader.shortint();
+            std::string queue = reader.shortstr();
+            std::string tag = reader.shortstr();
+            uint8_t bits = reader.octet();
+            if(tag.empty())
+                tag = "amq.ctag-" + std::to_string(++_tag_seq);
+            auto consumer = std::make_shared<Consumer>(Consumer{conn, channel, tag, queue, conn->channels[channel].prefetch, 0, (bits & 0x02) != 0});
+            _queues[queue].consumers.push_back(consumer);
+            if(!(bits & 0x08))
+                sendMethod(conn, channel, 60, 21, Writer().shortstr(tag));
+            dispatch(queue);
+            break;
+        }
+        case (60 << 16) | 30: // basic.cancel
+        {
+            std::string tag = reader.shortstr();
+            uint8_t bits = reader.octet();
+            removeConsumers([conn, channel, &tag](const Consumer& c){
+                return c.conn == conn && c.channel == channel && c.tag == tag;
+            });
+            if(!(bits & 0x01))
+                sendMethod(conn, channel, 60, 31, Writer().shortstr(tag));
+            break;
+        }
+        case (60 << 16) | 40: // basic.publish
+        {
+            reader.shortint();
+            Channel& ch = conn->channels[channel];
+            ch.publishing = true;
+            ch.pending = Message();
+            ch.pending.exchange = reader.shortstr();
+            ch.pending.routing_key = reader.shortstr();
+            ch.pending.redelivered = false;
+            break;
+        }
+        case (60 << 16) | 80: // basic.ack
+        {
+            uint64_t tag = reader.longlong();
+            bool multiple = reader.octet() & 0x01;
+            settle(conn, channel, tag, multiple, false);
+            break;
+        }
+        case (60 << 16) | 90: // basic.reject
+        {
+            uint64_t tag = reader.longlong();
+            bool requeue = reader.octet() & 0x01;
+            settle(conn, channel, tag, false, requeue);
+            break;
+        }
+        case (60 << 16) | 120: // basic.nack
+        {
+            uint64_t tag = reader.longlong();
+            uint8_t bits = reader.octet();
+            settle(conn, channel, tag, bits & 0x01, bits & 0x02);
+            break;
+        }
+        case (85 << 16) | 10: // confirm.select
+        {
+            uint8_t bits = reader.octet();
+            conn->channels[channel].confirm = true;
+            if(!(bits & 0x01))
+                sendMethod(conn, channel, 85, 11, Writer());
+            break;
+        }
+        default:
+            LOG_WARN("AMQP 替身服务器忽略不支持的方法 {}.{}", class_id, method_id);
+            break;
+        }
+    }
+
+    void onHeader(Connection* conn, uint16_t channel, const std::string& payload)
+    {
+        Channel& ch = conn->channels[channel];
+        if(!ch.publishing)
+            return;
+        Reader reader(payload);
+        reader.shortint();
+        reader.shortint();
+        ch.pending.body_size = reader.longlong();
+        ch.pending.properties = reader.rest();
+        if(ch.pending.body_size == 0)
+        {
+            ch.publishing = false;
+            published(conn, channel, ch);
+        }
+    }
+
+    void onBody(Connection* conn, uint16_t channel, const std::string& payload)
+    {
+        Channel& ch = conn->channels[channel];
+        if(!ch.publishing)
+            return;
+        ch.pending.body.append(payload);
+        if(ch.pending.body.size() >= ch.pending.body_size)
+        {
+            ch.publishing = false;
+            published(conn, channel, ch);
+        }
+    }
+
+    // 消息接收完整后路由，确认模式下立即回复 basic.ack(消息不持久化，路由即视为已接收)
+    void published(Connection* conn, uint16_t channel, Channel& ch)
+    {
+        route(std::move(ch.pending));
+        if(ch.confirm)
+            sendMethod(conn, channel, 60, 80, Writer().longlong(++ch.published).octet(0));
+    }
+
+    void route(Message message)
+    {
+        std::vector<std::string> targets;
+        if(message.exchange.empty())
+        {
+            // 默认交换机直接以路由键作为队列名
+            targets.push_back(message.routing_key);
+        }
+        else
+        {
+            bool fanout = _exchanges[message.exchange] == "fanout";
+            for(const auto& binding : _bindings[message.exchange])
+            {
+                if(fanout || binding.first == message.routing_key)
+                    targets.push_back(binding.second);
+            }
+        }
+        for(const auto& name : targets)
+        {
+            auto it = _queues.find(name);
+            if(it == _queues.end())
+                continue;
+            it->second.messages.push_back(message);
+            dispatch(name);
+        }
+    }
+
+    // 将队列中的消息轮转投递给仍有预取额度的消费者
+    void dispatch(const std::string& name)
+    {
+        Queue& queue = _queues[name];
+        while(!queue.messages.empty() && !queue.consumers.empty())
+        {
+            std::shared_ptr<Consumer> consumer;
+            for(size_t i = 0; i < queue.consumers.size(); ++i)
+            {
+                auto& candidate = queue.consumers[(queue.cursor + i) % queue.consumers.size()];
+                if(candidate->no_ack || candidate->prefetch == 0 || candidate->unacked < candidate->prefetch)
+                {
+                    consumer = candidate;
+                    queue.cursor = (queue.cursor + i + 1) % queue.consumers.size();
+                    break;
+                }
+            }
+            if(!consumer)
+                break;
+            Message message = std::move(queue.messages.front());
+            queue.messages.pop_front();
+            deliver(consumer, std::move(message));
+        }
+    }
+
+    void deliver(const std::shared_ptr<Consumer>& consumer, Message message)
+    {
+        Connection* conn = consumer->conn;
+        Channel& ch = conn->channels[consumer->channel];
+        uint64_t tag = ch.next_tag++;
+        Writer method;
+        method.shortstr(consumer->tag).longlong(tag).octet(message.redelivered ? 1 : 0).shortstr(message.exchange).shortstr(message.routing_key);
+        sendMethod(conn, consumer->channel, 60, 60, method);
+        Writer header;
+        header.shortint(60).shortint(0).longlong(message.body.size()).raw(message.properties);
+        sendFrame(conn, FRAME_HEADER, consumer->channel, header.data());
+        size_t chunk = conn->frame_max - 8;
+        for(size_t offset = 0; offset < message.body.size(); offset += chunk)
+            sendFrame(conn, FRAME_BODY, consumer->channel, message.body.substr(offset, chunk));
+        if(!consumer->no_ack)
+        {
+            ++consumer->unacked;
+            ch.unacked[tag] = Unacked{std::move(message), consumer};
+        }
+    }
+
+    // 确认或拒绝投递，requeue 为 true 时消息以重投标记放回队首
+    void settle(Connection* conn, uint16_t channel, uint64_t tag, bool multiple, bool requeue)
+    {
+        Channel& ch = conn->channels[channel];
+        // multiple 且 tag 为 0 时表示全部未确认的投递
+        auto end = multiple ? (tag == 0 ? ch.unacked.end() : ch.unacked.upper_bound(tag)) : ch.unacked.find(tag);
+        auto begin = multiple ? ch.unacked.begin() : end;
+        if(!multiple && end != ch.unacked.end())
+            ++end;
+        std::vector<std::string> queues;
+        for(auto it = begin; it != end; ++it)
+        {
+            --it->second.consumer->unacked;
+            queues.push_back(it->second.consumer->queue);
+            if(requeue)
+            {
+                it->second.message.redelivered = true;
+                _queues[it->second.consumer->queue].messages.push_front(std::move(it->second.message));
+            }
+        }
+        ch.unacked.erase(begin, end);
+        for(const auto& name : queues)
+            dispatch(name);
+    }
+
+    void closeChannel(Connection* conn, uint16_t channel)
+    {
+        auto it = conn->channels.find(channel);
+        if(it == conn->channels.end())
+            return;
+        removeConsumers([conn, channel](const Consumer& c){
+            return c.conn == conn && c.channel == channel;
+        });
+        // 未确认的消息重新入队
+        std::vector<std::string> queues;
+        for(auto rit = it->second.unacked.rbegin(); rit != it->second.unacked.rend(); ++rit)
+        {
+            rit->second.message.redelivered = true;
+            queues.push_back(rit->second.consumer->queue);
+            _queues[rit->second.consumer->queue].messages.push_front(std::move(rit->second.message));
+        }
+        conn->channels.erase(it);
+        for(const auto& name : queues)
+            dispatch(name);
+    }
+
+    template<typename Pred>
+    void removeConsumers(const Pred& pred)
+    {
+        for(auto& it : _queues)
+        {
+            auto& consumers = it.second.consumers;
+            consumers.erase(std::remove_if(consumers.begin(), consumers.end(), [&pred](const std::shared_ptr<Consumer>& c){
+                return pred(*c);
+            }), consumers.end());
+            it.second.cursor = 0;
+        }
+    }
+
+    void destroy(Connection* conn)
+    {
+        std::vector<uint16_t> channels;
+        for(const auto& it : conn->channels)
+            channels.push_back(it.first);
+        for(auto channel : channels)
+            closeChannel(conn, channel);
+        ev_io_stop(_loop, &conn->read_watcher);
+        ev_io_stop(_loop, &conn->write_watcher);
+        close(conn->fd);
+        _connections.erase(conn->fd);
+    }
+
+    void sendMethod(Connection* conn, uint16_t channel, uint16_t class_id, uint16_t method_id, const Writer& args)
+    {
+        Writer method;
+        method.shortint(class_id).shortint(method_id).raw(args.data());
+        sendFrame(conn, FRAME_METHOD, channel, method.data());
+    }
+
+    void sendFrame(Connection* conn, uint8_t type, uint16_t channel, const std::string& payload)
+    {
+        Writer frame;
+        frame.octet(type).shortint(channel).longint(payload.size()).raw(payload).octet(FRAME_END);
+        conn->out.append(frame.data());
+        flush(conn);
+    }
+
+    void flush(Connection* conn)
+    {
+        while(!conn->out.empty())
+        {
+            ssize_t n = send(conn->fd, conn->out.data(), conn->out.size(), MSG_NOSIGNAL);
+            if(n < 0)
+            {
+                if(errno == EAGAIN || errno == EINTR)
+                    break;
+                conn->out.clear();
+                conn->closed = true;
+                break;
+            }
+            conn->out.erase(0, n);
+        }
+        if(!conn->out.empty() && !conn->writing)
+        {
+            ev_io_start(_loop, &conn->write_watcher);
+            conn->writing = true;
+        }
+        else if(conn->out.empty() && conn->writing)
+        {
+            ev_io_stop(_loop, &conn->write_watcher);
+            conn->writing = false;
+        }
+    }
+
+private:
+    struct ev_loop* _loop;
+    int _listen_fd;
+    uint16_t _port;
+    ev_io _accept_watcher;
+    ev_async _stop_watcher;
+    ev_timer _heartbeat_timer;
+    std::thread _loop_thread;
+
+    // 以下成员只在事件循环线程中访问
+    uint64_t _queue_seq;
+    uint64_t _tag_seq;
+    std::unordered_map<int, std::unique_ptr<Connection>> _connections;
+    std::unordered_map<std::string, std::string> _exchanges; // 交换机名称 -> 类型
+    std::unordered_map<std::string, std::set<std::pair<std::string, std::string>>> _bindings; // 交换机 -> (路由键, 队列)，重复绑定不生效
+    std::unordered_map<std::string, Queue> _queues;
+};
+}
@@ -0,0 +1,215 @@
+// ES 写入/搜索客户端开销压测
+// 使用进程内的 ES 替身服务器(es_standin.hpp)，不依赖 ES 集群；测的是 icsearch.hpp 自身的请求体序列化、HTTP 往返和结果解析，
+// 替身服务器处理请求的耗时单独统计，client(us) 列为平均耗时扣除服务端处理后剩下的客户端与传输开销
+// 用法: es_bench [每组请求数，默认 20000]
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include "es_standin.hpp"
+#include "../common/icsearch.hpp"
+
+namespace {
+const char* INDEX = "bench_message"; // 搜索用的索引，文档数固定
+const char* WRITE_INDEX = "bench_write"; // 写入压测用的索引，避免影响搜索的耗时
+const char* TYPE = "_doc";
+const size_t DOCUMENTS = 1000; // 搜索前预先写入的文档数
+
+struct Message
+{
+    std::string message_id;
+    std::string chat_session_id;
+    std::string user_id;
+    int64_t create_time = 0;
+    std::string content;
+};
+
+int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Json::Value message(size_t i)
+{
+    Json::Value doc;
+    doc["message_id"] = "7f3a9c2e" + std::to_string(10000000 + i);
+    doc["chat_session_id"] = "session-" + std::to_string(i % 16);
+    doc["user_id"] = "a1b2c3d4e5f6" + std::to_string(1000 + i % 50);
+    doc["create_time"] = std::to_string(1729300000 + i);
+    doc["content"] = i % 4 == 0 ? "今天晚上一起去吃火锅吗？地点还是老地方，七点见 #" + std::to_string(i)
+        : "明天的会议改到下午三点，记得带上周报 #" + std::to_string(i);
+    return doc;
+}
+
+// 与消息服务的消息搜索相同的条件：会话内按内容匹配
+hmy::ESSearch searchRequest(std::shared_ptr<elasticlient::Client>& client, size_t i)
+{
+    hmy::ESSearch search(client, INDEX, TYPE);
+    search.append_must_match("chat_session_id.keyword", "session-" + std::to_string(i % 16))
+        .append_should_match("content", "火锅")
+        .append_must_not_terms("user_id.keyword", {"blocked-1", "blocked-2"})
+        .size(20);
+    return search;
+}
+
+struct Result
+{
+    std::vector<int64_t> latencies;
+    double seconds;
+    hmy::ESStandin::Stats server;
+    bool concurrent = false; // 请求并发执行时服务端耗时相互重叠，不计算客户端开销
+};
+
+void print(const char* name, size_t count, const Result& result)
+{
+    double avg_us = result.seconds * 1e6 / count;
+    double server_us = (double)result.server.handler_us / count;
+    if(result.latencies.empty())
+    {
+        printf("%-14s %10.0f %10s %10s %10.1f %10.1f\n", name, count / result.seconds, "-", "-", server_us, avg_us - server_us);
+        return;
+    }
+    char client[16] = "-";
+    if(!result.concurrent)
+        snprintf(client, sizeof(client), "%.1f", avg_us - server_us);
+    std::vector<int64_t> latencies = result.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p){
+        return latencies[std::min(latencies.size() - 1, (size_t)(p * latencies.size()))] / 1000.0;
+    };
+    printf("%-14s %10.0f %10.1f %10.1f %10.1f %10s\n", name, count / result.seconds, percentile(0.5), percentile(0.99), server_us, client);
+}
+
+// 串行执行 count 次 func，记录每次的耗时
+template<typename Func>
+Result measure(hmy::ESStandin& server, size_t count, Func&& func)
+{
+    Result result;
+    result.latencies.reserve(count);
+    hmy::ESStandin::Stats before = server.stats();
+    int64_t start = now_ns();
+    for(size_t i = 0; i < count; ++i)
+    {
+        int64_t begin = now_ns();
+        if(!func(i))
+        {
+            fprintf(stderr, "第 %zu 次请求失败\n", i);
+            exit(1);
+        }
+        result.latencies.push_back(now_ns() - begin);
+    }
+    result.seconds = (now_ns() - start) / 1e9;
+    hmy::ESStandin::Stats after = server.stats();
+    result.server = hmy::ESStandin::Stats{after.requests - before.requests, after.handler_us - before.handler_us};
+    return result;
+}
+
+// 异步搜索：保持 window 个请求在途，延迟为发出到取得结果的时间
+Result measureAsync(hmy::ESStandin& server, std::shared_ptr<elasticlient::Client>& client, size_t count, size_t window)
+{
+    hmy::ESAsyncClient::ptr async = std::make_shared<hmy::ESAsyncClient>(std::vector<std::string>{server.host()});
+    Result result;
+    result.latencies.reserve(count);
+    result.concurrent = true;
+    hmy::ESStandin::Stats before = server.stats();
+    int64_t start = now_ns();
+    std::vector<std::pair<int64_t, std::future<Json::Value>>> inflight;
+    for(size_t i = 0; i < count; i += window)
+    {
+        for(size_t j = i; j < std::min(count, i + window); ++j)
+            inflight.emplace_back(now_ns(), searchRequest(client, j).nocache().search_async(async));
+        for(auto& [begin, future] : inflight)
+        {
+            if(!future.get().isArray())
+            {
+                fprintf(stderr, "异步搜索失败\n");
+                exit(1);
+            }
+            result.latencies.push_back(now_ns() - begin);
+        }
+        inflight.clear();
+    }
+    result.seconds = (now_ns() - start) / 1e9;
+    hmy::ESStandin::Stats after = server.stats();
+    result.server = hmy::ESStandin::Stats{after.requests - before.requests, after.handler_us - before.handler_us};
+    return result;
+}
+
+Result measureBulk(hmy::ESStandin& server, std::shared_ptr<elasticlient::Client>& client, size_t count)
+{
+    Result result;
+    hmy::ESStandin::Stats before = server.stats();
+    int64_t start = now_ns();
+    {
+        hmy::ESBulkWriter writer(client, WRITE_INDEX, TYPE);
+        writer.setErrorCallback([](const hmy::ESBulkError& error){
+            fprintf(stderr, "批量写入 %s 失败: %d %s\n", error.id.c_str(), error.status, error.reason.c_str());
+            exit(1);
+        });
+        for(size_t i = 0; i < count; ++i)
+        {
+            Json::Value doc = message(i);
+            writer.index(doc, doc["message_id"].asString());
+        }
+        writer.flush();
+    }
+    result.seconds = (now_ns() - start) / 1e9;
+    hmy::ESStandin::Stats after = server.stats();
+    result.server = hmy::ESStandin::Stats{after.requests - before.requests, after.handler_us - before.handler_us};
+    return result;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    hmy::init_logger(true, "es_bench.log", spdlog::level::warn);
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+
+    hmy::ESStandin server;
+    auto client = std::make_shared<elasticlient::Client>(std::vector<std::string>{server.host()});
+    for(size_t i = 0; i < DOCUMENTS; ++i)
+    {
+        Json::Value doc = message(i);
+        hmy::ESInsert insert(client, INDEX, TYPE);
+        for(const auto& key : doc.getMemberNames())
+            insert.append(key, doc[key].asString());
+        insert.insert(doc["message_id"].asString());
+    }
+    if(server.count(INDEX) != DOCUMENTS || searchRequest(client, 0).nocache().search().size() == 0)
+    {
+        fprintf(stderr, "替身服务器初始化失败\n");
+        return 1;
+    }
+
+    hmy::ESHitDecoder<Message> decoder;
+    decoder.id(&Message::message_id)
+        .field("chat_session_id", &Message::chat_session_id)
+        .field("user_id", &Message::user_id)
+        .field("create_time", &Message::create_time)
+        .field("content", &Message::content);
+
+    printf("%-14s %10s %10s %10s %10s %10s\n", "op", "ops/s", "p50(us)", "p99(us)", "server(us)", "client(us)");
+    print("insert", count, measure(server, count, [&](size_t i){
+        Json::Value doc = message(i);
+        hmy::ESInsert insert(client, WRITE_INDEX, TYPE);
+        for(const auto& key : doc.getMemberNames())
+            insert.append(key, doc[key].asString());
+        return insert.insert(doc["message_id"].asString());
+    }));
+    print("remove", count, measure(server, count, [&](size_t i){
+        return hmy::ESRemove(client, WRITE_INDEX, TYPE).remove(message(i)["message_id"].asString());
+    }));
+    print("bulk", count, measureBulk(server, client, count));
+    print("search", count, measure(server, count, [&](size_t i){
+        return searchRequest(client, i).nocache().search().isArray();
+    }));
+    print("search_as", count, measure(server, count, [&](size_t i){
+        std::vector<Message> out;
+        return searchRequest(client, i).search_as(decoder, out);
+    }));
+    print("search_async", count, measureAsync(server, client, count, 16));
+    hmy::init_es_search_cache();
+    print("search_cached", count, measure(server, count, [&](size_t i){
+        return searchRequest(client, i).search().isArray();
+    }));
+    return 0;
+}
@@ -0,0 +1,107 @@
+// ES 搜索结果解码压测
+// 对比先反序列化为 Json::Value 再逐个取字段的旧做法与 ESHitDecoder 的流式解码，
+// 响应取消息搜索的典型结果：每条命中包含 _id/_score/_source，_source 中有 5 个字段，只取其中 4 个
+// 用法: es_decode_bench [每组迭代次数，默认 20000]
+#include <chrono>
+#include <cstdlib>
+#include "../common/icsearch.hpp"
+
+namespace {
+struct Message
+{
+    std::string message_id;
+    std::string chat_session_id;
+    std::string user_id;
+    int64_t create_time = 0;
+    std::string content;
+};
+
+std::string response(size_t hits)
+{
+    Json::Value arr(Json::arrayValue);
+    for(size_t i = 0; i < hits; ++i)
+    {
+        Json::Value hit;
+        hit["_id"] = "7f3a9c2e1b4d" + std::to_string(10000 + i);
+        hit["_score"] = 3.14159 - i * 0.01;
+        hit["_source"]["message_id"] = hit["_id"];
+        hit["_source"]["chat_session_id"] = "session-00012345";
+        hit["_source"]["user_id"] = "a1b2c3d4e5f60718";
+        hit["_source"]["create_time"] = std::to_string(1729300000 + i);
+        hit["_source"]["content"] = "今天晚上一起去吃火锅吗？\n地点还是老地方，七点见，不见不散！\"Let's go~\" #" + std::to_string(i);
+        arr.append(hit);
+    }
+    Json::Value root;
+    root["hits"]["hits"] = arr;
+    std::string text;
+    hmy::Serialize(root, text);
+    return text;
+}
+
+// 旧做法：完整 DOM + 逐字段拷贝
+bool domDecode(const std::string& text, std::vector<Message>& out)
+{
+    Json::Value root;
+    if(!hmy::UnSerialize(text, root))
+        return false;
+    const Json::Value& hits = root["hits"]["hits"];
+    for(Json::ArrayIndex i = 0; i < hits.size(); ++i)
+    {
+        const Json::Value& source = hits[i]["_source"];
+        Message& msg = out.emplace_back();
+        msg.message_id = hits[i]["_id"].asString();
+        msg.user_id = source["user_id"].asString();
+        msg.create_time = std::strtoll(source["create_time"].asCString(), nullptr, 10);
+        msg.content = source["content"].asString();
+    }
+    return true;
+}
+
+template<typename Func>
+double measure(size_t count, Func&& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < count; ++i)
+        func();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+void run(const hmy::ESHitDecoder<Message>& decoder, size_t hits, size_t count)
+{
+    std::string text = response(hits);
+    std::vector<Message> dom, stream;
+    std::string err;
+    if(!domDecode(text, dom) || !decoder.decode(text.data(), text.size(), stream, err) || dom.size() != stream.size())
+    {
+        fprintf(stderr, "解码失败: %s\n", err.c_str());
+        exit(1);
+    }
+    for(size_t i = 0; i < dom.size(); ++i)
+    {
+        if(dom[i].message_id != stream[i].message_id || dom[i].user_id != stream[i].user_id
+            || dom[i].create_time != stream[i].create_time || dom[i].content != stream[i].content)
+        {
+            fprintf(stderr, "第 %zu 条结果不一致\n", i);
+            exit(1);
+        }
+    }
+
+    double dom_us = measure(count, [&](){ dom.clear(); domDecode(text, dom); });
+    double stream_us = measure(count, [&](){ stream.clear(); decoder.decode(text.data(), text.size(), stream, err); });
+    printf("%6zu %9zu %12.1f %12.1f %8.1fx\n", hits, text.size(), dom_us, stream_us, dom_us / stream_us);
+}
+}
+
+int main(int argc, char* argv[])
+{
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    hmy::ESHitDecoder<Message> decoder;
+    decoder.id(&Message::message_id)
+        .field("user_id", &Message::user_id)
+        .field("create_time", &Message::create_time)
+        .field("content", &Message::content);
+    printf("%6s %9s %12s %12s %9s\n", "hits", "bytes", "dom(us)", "stream(us)", "speedup");
+    for(size_t hits : {10, 100, 1000})
+        run(decoder, hits, hits >= 1000 ? count / 10 : count);
+    return 0;
+}
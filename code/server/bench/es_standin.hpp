@@ -0,0 +1,859 @@
+#pragma once
+#include <json/json.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../common/httplib.h"
+#include "../common/logger.hpp"
+#include "../common/jsoncodec.hpp"
+
+// 进程内 Elasticsearch 替身服务器，用于在没有 ES 集群的环境下测试和压测 icsearch.hpp
+// 基于 httplib，数据只保存在内存中，只实现 icsearch.hpp 用到的子集：
+//   PUT/HEAD/DELETE /{index}                   创建/检查/删除索引(映射和设置被忽略)
+//   PUT/POST /{index}/{type}/{id}, POST /{index}/{type}   新增文档
+//   GET/DELETE /{index}/{type}/{id}            读取/删除文档
+//   POST /_bulk, /{index}/_bulk                index/create/delete 操作
+//   GET/POST /{index}[/{type}]/_search         bool(must/should/must_not/filter) 组合的 match/multi_match/term/terms/range/prefix/match_all，
+//                                              以及 size/from/_source/sort/search_after；index 可以是逗号分隔的多个索引
+// 分词只做简化处理：ASCII 字母数字按连续串切分并转小写，其他字符(如汉字)每个字符一个词；
+// 字段名的 .keyword 后缀按原值精确匹配，.prefix 后缀按词前缀匹配，别名、路由、打分细节均不模拟
+namespace hmy{
+class ESStandin
+{
+public:
+    struct Stats
+    {
+        uint64_t requests; // 已处理的请求数
+        uint64_t handler_us; // 处理请求(不含网络收发和 HTTP 解析)的累计耗时
+    };
+
+    // port 为 0 时由系统分配端口，通过 port() 获取
+    ESStandin(uint16_t port = 0)
+    : _requests(0), _handler_us(0), _seq(0)
+    {
+        // 客户端会保持多条 keep-alive 连接，每条连接占用一个工作线程
+        _server.new_task_queue = [](){ return new httplib::ThreadPool(64); };
+        _server.set_tcp_nodelay(true);
+        routes();
+        if(port == 0)
+            _port = _server.bind_to_any_port("127.0.0.1");
+        else
+            _port = _server.bind_to_port("127.0.0.1", port) ? port : -1;
+        if(_port <= 0)
+        {
+            LOG_ERROR("ES 替身服务器监听端口 {} 失败", port);
+            abort();
+        }
+        _thread = std::thread([this](){ _server.listen_after_bind(); });
+        _server.wait_until_ready();
+    }
+
+    ~ESStandin()
+    {
+        _server.stop();
+        _thread.join();
+    }
+
+    uint16_t port() const
+    {
+        return _port;
+    }
+
+    // elasticlient::Client / ESAsyncClient 使用的节点地址
+    std::string host() const
+    {
+        return "http://127.0.0.1:" + std::to_string(_port) + "/";
+    }
+
+    // 索引中的文档数，索引不存在时为 0
+    size_t count(const std::string& index)
+    {
+        std::shared_lock lock(_mutex);
+        auto it = _indices.find(index);
+        return it == _indices.end() ? 0 : it->second.size();
+    }
+
+    Stats stats() const
+    {
+        return Stats{_requests.load(), _handler_us.load()};
+    }
+private:
+    struct Doc
+    {
+        Json::Value source;
+        uint64_t seq; // 写入顺序，相同得分的结果按写入顺序返回
+        std::unordered_map<std::string, std::vector<std::string>> terms; // 字符串字段写入时分好的词
+    };
+    using Index = std::unordered_map<std::string, Doc>;
+
+    struct Hit
+    {
+        const std::string* index;
+        const std::string* id;
+        const Doc* doc;
+        double score;
+    };
+
+    struct SortKey
+    {
+        std::string field;
+        bool asc;
+    };
+
+    // 查询条件编译后的匹配函数，命中时 score 累加得分
+    using Matcher = std::function<bool(const Doc&, double&)>;
+
+    using Handler = std::function<void(const httplib::Request&, httplib::Response&)>;
+
+    // 统计处理耗时
+    Handler timed(Handler handler)
+    {
+        return [this, handler](const httplib::Request& req, httplib::Response& res){
+            auto start = std::chrono::steady_clock::now();
+            handler(req, res);
+            _handler_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+            _requests.fetch_add(1, std::memory_order_relaxed);
+        };
+    }
+
+    // httplib 按登记顺序匹配，_search/_bulk 必须在文档路由之前
+    void routes()
+    {
+        const std::string index = "/([^/_][^/]*)";
+        const std::string segment = "/([^/]+)";
+        auto search = timed([this](const httplib::Request& req, httplib::Response& res){ onSearch(req, res); });
+        auto bulk = timed([this](const httplib::Request& req, httplib::Response& res){ onBulk(req, res); });
+        _server.Get(index + segment + "/_search", search).Post(index + segment + "/_search", search);
+        _server.Get(index + "/_search", search).Post(index + "/_search", search);
+        _server.Post("/_bulk", bulk).Post(index + "/_bulk", bulk);
+
+        auto put = timed([this](const httplib::Request& req, httplib::Response& res){ onIndexDoc(req, res); });
+        _server.Put(index + segment + segment, put).Post(index + segment + segment, put).Post(index + segment, put);
+        _server.Get(index + segment + segment, timed([this](const httplib::Request& req, httplib::Response& res){ onGetDoc(req, res); }));
+        _server.Delete(index + segment + segment, timed([this](const httplib::Request& req, httplib::Response& res){ onDeleteDoc(req, res); }));
+
+        _server.Put(index, timed([this](const httplib::Request& req, httplib::Response& res){ onCreateIndex(req, res); }));
+        _server.Get(index, timed([this](const httplib::Request& req, httplib::Response& res){ onHeadIndex(req, res); }));
+        _server.Delete(index, timed([this](const httplib::Request& req, httplib::Response& res){ onDeleteIndex(req, res); }));
+    }
+
+    static void reply(httplib::Response& res, int status, const Json::Value& body)
+    {
+        std::string text;
+        Serialize(body, text);
+        res.status = status;
+        res.set_content(text, "application/json");
+    }
+
+    static void error(httplib::Response& res, int status, const std::string& type, const std::string& reason)
+    {
+        Json::Value body;
+        body["error"]["type"] = type;
+        body["error"]["reason"] = reason;
+        body["status"] = status;
+        reply(res, status, body);
+    }
+
+    std::string newId()
+    {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "sa%016lx", (unsigned long)_seq.fetch_add(1));
+        return buf;
+    }
+
+    // ---------------- 索引 ----------------
+    void onCreateIndex(const httplib::Request& req, httplib::Response& res)
+    {
+        std::unique_lock lock(_mutex);
+        if(!_indices.emplace(req.matches[1], Index()).second)
+            return error(res, 400, "resource_already_exists_exception", "index [" + req.matches[1].str() + "] already exists");
+        Json::Value body;
+        body["acknowledged"] = true;
+        body["index"] = req.matches[1].str();
+        reply(res, 200, body);
+    }
+
+    void onHeadIndex(const httplib::Request& req, httplib::Response& res)
+    {
+        std::shared_lock lock(_mutex);
+        if(_indices.count(req.matches[1]) == 0)
+            return error(res, 404, "index_not_found_exception", "no such index [" + req.matches[1].str() + "]");
+        reply(res, 200, Json::Value(Json::objectValue));
+    }
+
+    void onDeleteIndex(const httplib::Request& req, httplib::Response& res)
+    {
+        std::unique_lock lock(_mutex);
+        if(_indices.erase(req.matches[1]) == 0)
+            return error(res, 404, "index_not_found_exception", "no such index [" + req.matches[1].str() + "]");
+        Json::Value body;
+        body["acknowledged"] = true;
+        reply(res, 200, body);
+    }
+
+    // ---------------- 文档 ----------------
+    void onIndexDoc(const httplib::Request& req, httplib::Response& res)
+    {
+        Json::Value source;
+        if(UnSerialize(req.body, source) == false || !source.isObject())
+            return error(res, 400, "mapper_parsing_exception", "failed to parse");
+        std::string id = req.matches.size() > 3 ? req.matches[3].str() : newId();
+        bool created;
+        {
+            std::unique_lock lock(_mutex);
+            created = put(_indices[req.matches[1]], id, std::move(source));
+        }
+        Json::Value body;
+        body["_index"] = req.matches[1].str();
+        body["_id"] = id;
+        body["result"] = created ? "created" : "updated";
+        reply(res, created ? 201 : 200, body);
+    }
+
+    void onGetDoc(const httplib::Request& req, httplib::Response& res)
+    {
+        std::shared_lock lock(_mutex);
+        Json::Value body;
+        body["_index"] = req.matches[1].str();
+        body["_id"] = req.matches[3].str();
+        const Doc* doc = find(req.matches[1], req.matches[3]);
+        body["found"] = doc != nullptr;
+        if(doc)
+            body["_source"] = doc->source;
+        reply(res, doc ? 200 : 404, body);
+    }
+
+    void onDeleteDoc(const httplib::Request& req, httplib::Response& res)
+    {
+        bool found;
+        {
+            std::unique_lock lock(_mutex);
+            auto it = _indices.find(req.matches[1]);
+            found = it != _indices.end() && it->second.erase(req.matches[3]) > 0;
+        }
+        Json::Value body;
+        body["_index"] = req.matches[1].str();
+        body["_id"] = req.matches[3].str();
+        body["result"] = found ? "deleted" : "not_found";
+        reply(res, found ? 200 : 404, body);
+    }
+
+    // 返回是否为新文档，调用方持有写锁
+    bool put(Index& index, const std::string& id, Json::Value&& source)
+    {
+        Doc& doc = index[id];
+        bool created = doc.source.isNull();
+        doc.source = std::move(source);
+        doc.seq = _seq.fetch_add(1);
+        doc.terms.clear();
+        for(auto it = doc.source.begin(); it != doc.source.end(); ++it)
+        {
+            if(it->isString())
+                doc.terms.emplace(it.name(), tokenize(it->asString()));
+        }
+        return created;
+    }
+
+    const Doc* find(const std::string& index, const std::string& id) const
+    {
+        auto it = _indices.find(index);
+        if(it == _indices.end())
+            return nullptr;
+        auto dit = it->second.find(id);
+        return dit == it->second.end() ? nullptr : &dit->second;
+    }
+
+    // ---------------- _bulk ----------------
+    void onBulk(const httplib::Request& req, httplib::Response& res)
+    {
+        std::string default_index = req.matches.size() > 1 ? req.matches[1].str() : "";
+        Json::Value items(Json::arrayValue);
+        bool errors = false;
+        size_t pos = 0;
+        const std::string& text = req.body;
+        std::unique_lock lock(_mutex);
+        while(pos < text.size())
+        {
+            size_t end = text.find('\n', pos);
+            if(end == std::string::npos)
+                end = text.size();
+            std::string line = text.substr(pos, end - pos);
+            pos = end + 1;
+            if(line.empty())
+                continue;
+            Json::Value action;
+            if(UnSerialize(line, action) == false || !action.isObject() || action.size() != 1)
+            {
+                lock.unlock();
+                return error(res, 400, "illegal_argument_exception", "malformed action/metadata line");
+            }
+            std::string op = action.getMemberNames()[0];
+            const Json::Value& meta = action[op];
+            std::string index = meta.isMember("_index") ? meta["_index"].asString() : default_index;
+            std::string id = meta.isMember("_id") ? meta["_id"].asString() : "";
+            Json::Value source;
+            // 除 delete 外每个操作后面跟一行文档
+            if(op != "delete")
+            {
+                end = text.find('\n', pos);
+                if(end == std::string::npos)
+                    end = text.size();
+                if(UnSerialize(text.data() + pos, end - pos, source) == false)
+                    source = Json::Value();
+                pos = end + 1;
+            }
+
+            Json::Value item;
+            item["_index"] = index;
+            int status;
+            if(op != "index" && op != "create" && op != "delete")
+            {
+                status = 400;
+                item["error"]["type"] = "illegal_argument_exception";
+                item["error"]["reason"] = "unsupported action [" + op + "]";
+            }
+            else if(op == "delete")
+            {
+                auto it = _indices.find(index);
+                bool found = it != _indices.end() && it->second.erase(id) > 0;
+                status = found ? 200 : 404;
+                item["result"] = found ? "deleted" : "not_found";
+            }
+            else if(!source.isObject())
+            {
+                status = 400;
+                item["error"]["type"] = "mapper_parsing_exception";
+                item["error"]["reason"] = "failed to parse";
+            }
+            else
+            {
+                if(id.empty())
+                    id = newId();
+                Index& docs = _indices[index];
+                if(op == "create" && docs.count(id))
+                {
+                    status = 409;
+                    item["error"]["type"] = "version_conflict_engine_exception";
+                    item["error"]["reason"] = "[" + id + "]: version conflict, document already exists";
+                }
+                else
+                {
+                    status = put(docs, id, std::move(source)) ? 201 : 200;
+                    item["result"] = status == 201 ? "created" : "updated";
+                }
+            }
+            item["_id"] = id;
+            item["status"] = status;
+            // 与 ES 一致，删除不存在的文档不算错误
+            if(status >= 300 && !(op == "delete" && status == 404))
+                errors = true;
+            Json::Value wrapper;
+            wrapper[op] = item;
+            items.append(wrapper);
+        }
+        lock.unlock();
+        Json::Value body;
+        body["took"] = 0;
+        body["errors"] = errors;
+        body["items"] = items;
+        reply(res, 200, body);
+    }
+
+    // ---------------- _search ----------------
+    void onSearch(const httplib::Request& req, httplib::Response& res)
+    {
+        Json::Value request(Json::objectValue);
+        if(!req.body.empty() && (UnSerialize(req.body, request) == false || !request.isObject()))
+            return error(res, 400, "parsing_exception", "failed to parse search request");
+        const Json::Value& params = request; // 只读访问，operator[] 不会插入空成员
+        Json::Value query = params["query"];
+        if(query.isNull())
+            query["match_all"] = Json::Value(Json::objectValue);
+        Matcher matcher = compile(query);
+        std::vector<SortKey> keys = sortKeys(params["sort"]);
+        const Json::Value& after = params["search_after"];
+        size_t from = std::max(params.get("from", 0).asInt(), 0);
+        size_t size = std::max(params.get("size", 10).asInt(), 0);
+
+        std::vector<std::string> names = split(req.matches[1], ',');
+        std::shared_lock lock(_mutex);
+        std::vector<Hit> hits;
+        for(const auto& name : names)
+        {
+            auto it = _indices.find(name);
+            if(it == _indices.end())
+                continue;
+            hits.reserve(hits.size() + it->second.size());
+            for(const auto& [id, doc] : it->second)
+            {
+                double score = 0;
+                if(matcher(doc, score))
+                    hits.push_back(Hit{&it->first, &id, &doc, score});
+            }
+        }
+        size_t total = hits.size();
+        if(!keys.empty() && after.isArray())
+        {
+            hits.erase(std::remove_if(hits.begin(), hits.end(), [&](const Hit& hit){
+                return compareAfter(keys, hit, after) <= 0;
+            }), hits.end());
+        }
+        // 只需要排出前 from + size 条
+        auto last = hits.begin() + std::min(hits.size(), from + size);
+        std::partial_sort(hits.begin(), last, hits.end(), [&](const Hit& a, const Hit& b){
+            int c = compareHits(keys, a, b);
+            return c != 0 ? c < 0 : a.doc->seq < b.doc->seq;
+        });
+
+        Json::Value out(Json::arrayValue);
+        for(auto it = hits.begin() + std::min(hits.size(), from); it < last; ++it)
+        {
+            Json::Value item;
+            item["_index"] = *it->index;
+            item["_type"] = "_doc";
+            item["_id"] = *it->id;
+            item["_score"] = keys.empty() ? Json::Value(it->score) : Json::Value();
+            item["_source"] = project(it->doc->source, params["_source"]);
+            if(!keys.empty())
+                item["sort"] = sortValues(keys, *it);
+            out.append(item);
+        }
+        lock.unlock();
+        // 与 ES 一致，filter_path 过滤后没有命中时响应为空对象
+        if(out.empty() && req.has_param("filter_path"))
+            return reply(res, 200, Json::Value(Json::objectValue));
+        Json::Value body;
+        body["took"] = 0;
+        body["timed_out"] = false;
+        body["hits"]["total"]["value"] = (Json::UInt64)total;
+        body["hits"]["total"]["relation"] = "eq";
+        body["hits"]["hits"] = out;
+        reply(res, 200, body);
+    }
+
+    // 把查询条件编译为匹配函数，每次搜索只解析一次查询，逐文档匹配时不再访问查询的 Json
+    // 不支持的查询类型不命中任何文档
+    static Matcher compile(const Json::Value& query)
+    {
+        if(!query.isObject() || query.size() != 1)
+            return unsupported("");
+        std::string type = query.begin().name();
+        const Json::Value& body = *query.begin();
+        if(type == "match_all")
+            return [](const Doc&, double& score){ score += 1; return true; };
+        if(type == "bool")
+            return compileBool(body);
+        if(type == "multi_match")
+        {
+            std::vector<std::pair<Matcher, double>> fields;
+            bool all = body.get("operator", "or").asString() == "and";
+            for(const auto& spec : body["fields"])
+            {
+                std::string field = spec.asString();
+                double boost = 1;
+                size_t caret = field.find('^');
+                if(caret != std::string::npos)
+                {
+                    boost = atof(field.c_str() + caret + 1);
+                    field.resize(caret);
+                }
+                fields.emplace_back(compileText(field, body["query"].asString(), all), boost);
+            }
+            // 与 ES 默认的 best_fields 一致，取得分最高的字段
+            return [fields = std::move(fields)](const Doc& doc, double& score){
+                double best = 0;
+                bool hit = false;
+                for(const auto& [matcher, boost] : fields)
+                {
+                    double s = 0;
+                    if(matcher(doc, s))
+                    {
+                        hit = true;
+                        best = std::max(best, s * boost);
+                    }
+                }
+                score += best;
+                return hit;
+            };
+        }
+        if(!body.isObject() || body.size() != 1)
+            return unsupported(type);
+        std::string field = body.begin().name();
+        const Json::Value& arg = *body.begin();
+        if(type == "match")
+        {
+            if(!arg.isObject())
+                return compileText(field, arg.asString(), false);
+            return compileText(field, arg["query"].asString(), arg.get("operator", "or").asString() == "and");
+        }
+        if(type == "term" || type == "terms")
+        {
+            std::vector<Json::Value> values;
+            if(type == "term")
+                values.push_back(arg.isObject() ? arg["value"] : arg);
+            else
+                values.assign(arg.begin(), arg.end());
+            return [field, values = std::move(values)](const Doc& doc, double& score){
+                const Json::Value* value = fieldValue(doc.source, field);
+                if(value == nullptr || std::none_of(values.begin(), values.end(), [&](const Json::Value& v){ return equals(*value, v); }))
+                    return false;
+                score += 1;
+                return true;
+            };
+        }
+        if(type == "prefix")
+        {
+            std::string prefix = arg.isObject() ? arg["value"].asString() : arg.asString();
+            return [field, prefix](const Doc& doc, double& score){
+                const Json::Value* value = fieldValue(doc.source, field);
+                const char* begin;
+                const char* end;
+                if(value == nullptr || !value->getString(&begin, &end) || std::string_view(begin, end - begin).compare(0, prefix.size(), prefix) != 0)
+                    return false;
+                score += 1;
+                return true;
+            };
+        }
+        if(type == "range")
+        {
+            double low = -HUGE_VAL, high = HUGE_VAL;
+            bool low_inclusive = true, high_inclusive = true;
+            for(const char* op : {"gte", "gt", "lte", "lt"})
+            {
+                if(!arg.isMember(op))
+                    continue;
+                double bound;
+                if(!toNumber(arg[op], bound))
+                    return unsupported(type);
+                if(op[0] == 'g')
+                    low = bound, low_inclusive = op[2] == 'e';
+                else
+                    high = bound, high_inclusive = op[2] == 'e';
+            }
+            return [=](const Doc& doc, double& score){
+                const Json::Value* value = fieldValue(doc.source, field);
+                double v;
+                if(value == nullptr || !toNumber(*value, v))
+                    return false;
+                if(v < low || (v == low && !low_inclusive) || v > high || (v == high && !high_inclusive))
+                    return false;
+                score += 1;
+                return true;
+            };
+        }
+        return unsupported(type);
+    }
+
+    // 没有 must/filter 时 should 至少命中一条，否则 should 只影响得分(除非指定 minimum_should_match)
+    static Matcher compileBool(const Json::Value& body)
+    {
+        auto compileAll = [&](const char* key){
+            std::vector<Matcher> matchers;
+            for(const Json::Value* clause : clauses(body[key]))
+                matchers.push_back(compile(*clause));
+            return matchers;
+        };
+        std::vector<Matcher> must = compileAll("must"), filter = compileAll("filter");
+        std::vector<Matcher> must_not = compileAll("must_not"), should = compileAll("should");
+        int required = body.isMember("minimum_should_match") ? body["minimum_should_match"].asInt()
+            : (!should.empty() && must.empty() && filter.empty() ? 1 : 0);
+        return [=](const Doc& doc, double& score){
+            double s = 0, ignored = 0;
+            for(const auto& matcher : must)
+            {
+                if(!matcher(doc, s))
+                    return false;
+            }
+            for(const auto& matcher : filter)
+            {
+                if(!matcher(doc, ignored))
+                    return false;
+            }
+            for(const auto& matcher : must_not)
+            {
+                if(matcher(doc, ignored))
+                    return false;
+            }
+            int matched = 0;
+            for(const auto& matcher : should)
+                matched += matcher(doc, s);
+            if(matched < required)
+                return false;
+            score += s;
+            return true;
+        };
+    }
+
+    // 全文匹配，all 为 true(operator 为 and)时查询的每个词都要命中，得分为命中的词数
+    // 字段 a.b 不存在时按 a 的子字段 b 处理：keyword 精确匹配，prefix 按词前缀匹配，其他子字段(如 pinyin)不模拟
+    static Matcher compileText(const std::string& field, const std::string& text, bool all)
+    {
+        size_t dot = field.rfind('.');
+        std::string base = dot == std::string::npos ? field : field.substr(0, dot);
+        std::string sub = dot == std::string::npos ? "" : field.substr(dot + 1);
+        std::vector<std::string> words = tokenize(text);
+        return [=](const Doc& doc, double& score){
+            const Json::Value* value = doc.source.find(field.data(), field.data() + field.size());
+            bool plain = value != nullptr || sub.empty();
+            if(!plain)
+                value = doc.source.find(base.data(), base.data() + base.size());
+            if(value == nullptr)
+                return false;
+            if(!plain && sub == "keyword")
+            {
+                const char* begin;
+                const char* end;
+                if(value->getString(&begin, &end) ? std::string_view(begin, end - begin) != text : !equals(*value, Json::Value(text)))
+                    return false;
+                score += 1;
+                return true;
+            }
+            if((!plain && sub != "prefix") || value->isObject() || value->isArray())
+                return false;
+            std::vector<std::string> tokens;
+            const std::vector<std::string>* terms = &tokens;
+            auto it = doc.terms.find(plain ? field : base);
+            if(it != doc.terms.end())
+                terms = &it->second;
+            else
+                tokens = tokenize(value->asString());
+            int matched = 0;
+            for(const auto& word : words)
+            {
+                bool hit = std::any_of(terms->begin(), terms->end(), [&](const std::string& term){
+                    return plain ? term == word : term.compare(0, word.size(), word) == 0;
+                });
+                if(hit)
+                    ++matched;
+                else if(all)
+                    return false;
+            }
+            if(matched == 0)
+                return false;
+            score += matched;
+            return true;
+        };
+    }
+
+    static Matcher unsupported(const std::string& type)
+    {
+        LOG_WARN_RL("ES 替身服务器不支持的查询 {}", type);
+        return [](const Doc&, double&){ return false; };
+    }
+
+    // 子句可以是单个对象或对象数组
+    static std::vector<const Json::Value*> clauses(const Json::Value& val)
+    {
+        std::vector<const Json::Value*> out;
+        if(val.isArray())
+        {
+            for(const auto& clause : val)
+                out.push_back(&clause);
+        }
+        else if(val.isObject())
+            out.push_back(&val);
+        return out;
+    }
+
+    // 字段 a.keyword 不存在时取字段 a 的原值
+    static const Json::Value* fieldValue(const Json::Value& source, const std::string& field)
+    {
+        const Json::Value* value = source.find(field.data(), field.data() + field.size());
+        size_t dot = field.rfind('.');
+        if(value != nullptr || dot == std::string::npos || field.compare(dot + 1, std::string::npos, "keyword") != 0)
+            return value;
+        return source.find(field.data(), field.data() + dot);
+    }
+
+    // 字符串与数值、布尔值按字符串形式比较，与 keyword 字段的行为一致
+    static bool equals(const Json::Value& a, const Json::Value& b)
+    {
+        if(a.isString() && b.isString())
+            return a == b;
+        if(a.isString() || b.isString())
+            return (a.isString() || a.isNumeric() || a.isBool()) && (b.isString() || b.isNumeric() || b.isBool()) && a.asString() == b.asString();
+        return a == b;
+    }
+
+    static bool toNumber(const Json::Value& val, double& out)
+    {
+        if(val.isNumeric())
+        {
+            out = val.asDouble();
+            return true;
+        }
+        if(!val.isString())
+            return false;
+        const std::string& str = val.asString();
+        char* end;
+        out = strtod(str.c_str(), &end);
+        return !str.empty() && *end == '\0';
+    }
+
+    static std::vector<std::string> tokenize(const std::string& text)
+    {
+        std::vector<std::string> terms;
+        std::string word;
+        for(size_t i = 0; i < text.size();)
+        {
+            unsigned char c = text[i];
+            if(c < 0x80)
+            {
+                if(isalnum(c))
+                    word.push_back((char)tolower(c));
+                else if(!word.empty())
+                    terms.push_back(std::move(word)), word.clear();
+                ++i;
+                continue;
+            }
+            if(!word.empty())
+                terms.push_back(std::move(word)), word.clear();
+            size_t len = (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 1;
+            terms.push_back(text.substr(i, len));
+            i += len;
+        }
+        if(!word.empty())
+            terms.push_back(std::move(word));
+        return terms;
+    }
+
+    static Json::Value project(const Json::Value& source, const Json::Value& fields)
+    {
+        if(fields.isNull() || (fields.isBool() && fields.asBool()))
+            return source;
+        Json::Value out(Json::objectValue);
+        if(!fields.isArray())
+            return out;
+        for(const auto& field : fields)
+        {
+            std::string name = field.asString();
+            if(source.isMember(name))
+                out[name] = source[name];
+        }
+        return out;
+    }
+
+    static std::vector<SortKey> sortKeys(const Json::Value& sort)
+    {
+        std::vector<SortKey> keys;
+        if(sort.isString())
+            keys.push_back(SortKey{sort.asString(), sort.asString() != "_score"});
+        for(const Json::Value* clause : clauses(sort))
+        {
+            const Json::Value& spec = *clause;
+            if(spec.isString())
+            {
+                keys.push_back(SortKey{spec.asString(), spec.asString() != "_score"});
+                continue;
+            }
+            for(const auto& field : spec.getMemberNames())
+            {
+                const Json::Value& order = spec[field];
+                std::string dir = order.isObject() ? order.get("order", "asc").asString() : order.asString();
+                keys.push_back(SortKey{field, dir != "desc"});
+            }
+        }
+        return keys;
+    }
+
+    // _score/_id 的值放在 scratch 中
+    static const Json::Value* sortValue(const SortKey& key, const Hit& hit, Json::Value& scratch)
+    {
+        if(key.field == "_score")
+            return &(scratch = hit.score);
+        if(key.field == "_id")
+            return &(scratch = *hit.id);
+        return fieldValue(hit.doc->source, key.field);
+    }
+
+    static Json::Value sortValues(const std::vector<SortKey>& keys, const Hit& hit)
+    {
+        Json::Value values(Json::arrayValue);
+        for(const auto& key : keys)
+        {
+            Json::Value scratch;
+            const Json::Value* value = sortValue(key, hit, scratch);
+            values.append(value ? *value : Json::Value());
+        }
+        return values;
+    }
+
+    // 数值按数值比较，其余按字符串比较；缺失值不论升序降序都排在最后
+    static int compareValues(const Json::Value* a, const Json::Value* b, bool asc)
+    {
+        bool a_missing = a == nullptr || a->isNull();
+        bool b_missing = b == nullptr || b->isNull();
+        if(a_missing || b_missing)
+            return a_missing == b_missing ? 0 : a_missing ? 1 : -1;
+        int c;
+        double x, y;
+        if(toNumber(*a, x) && toNumber(*b, y))
+            c = x < y ? -1 : x > y ? 1 : 0;
+        else
+            c = a->asString().compare(b->asString());
+        return asc ? c : -c;
+    }
+
+    // 没有排序键时按得分从高到低
+    static int compareHits(const std::vector<SortKey>& keys, const Hit& a, const Hit& b)
+    {
+        if(keys.empty())
+            return a.score > b.score ? -1 : a.score < b.score ? 1 : 0;
+        Json::Value scratch_a, scratch_b;
+        for(const auto& key : keys)
+        {
+            int c = compareValues(sortValue(key, a, scratch_a), sortValue(key, b, scratch_b), key.asc);
+            if(c != 0)
+                return c;
+        }
+        return 0;
+    }
+
+    // 与 search_after 给出的排序值比较
+    static int compareAfter(const std::vector<SortKey>& keys, const Hit& hit, const Json::Value& after)
+    {
+        Json::Value scratch;
+        for(Json::ArrayIndex i = 0; i < keys.size() && i < after.size(); ++i)
+        {
+            int c = compareValues(sortValue(keys[i], hit, scratch), &after[i], keys[i].asc);
+            if(c != 0)
+                return c;
+        }
+        return 0;
+    }
+
+    static std::vector<std::string> split(const std::string& text, char sep)
+    {
+        std::vector<std::string> parts;
+        size_t pos = 0;
+        while(true)
+        {
+            size_t end = text.find(sep, pos);
+            parts.push_back(text.substr(pos, end - pos));
+            if(end == std::string::npos)
+                break;
+            pos = end + 1;
+        }
+        return parts;
+    }
+
+private:
+    httplib::Server _server;
+    int _port;
+    std::thread _thread;
+    std::atomic<uint64_t> _requests;
+    std::atomic<uint64_t> _handler_us;
+    std::atomic<uint64_t> _seq;
+    mutable std::shared_mutex _mutex;
+    std::unordered_map<std::string, Index> _indices;
+};
+}
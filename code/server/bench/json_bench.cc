@@ -0,0 +1,117 @@
+// Json 序列化/反序列化压测
+// 对比每次调用都新建 StreamWriterBuilder/CharReader 的旧实现、线程局部缓存的 jsoncpp 读写器和 JsonFastWriter，
+// 文档取 ES 中典型的用户文档和消息文档
+// 用法: json_bench [每组迭代次数，默认 200000]
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include "../common/jsoncodec.hpp"
+
+namespace {
+// 改造前 Serialize/UnSerialize 的实现，作为基准
+bool legacySerialize(const Json::Value& val, std::string& dst)
+{
+    Json::StreamWriterBuilder builder;
+    builder.settings_["emitUTF8"] = true;
+    std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+    std::stringstream ss;
+    if(writer->write(val, &ss) != 0)
+        return false;
+    dst = ss.str();
+    return true;
+}
+
+bool legacyUnSerialize(const std::string& src, Json::Value& val)
+{
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::stringstream ss;
+    std::string err;
+    return reader->parse(src.c_str(), src.c_str() + src.size(), &val, &err);
+}
+
+Json::Value userDocument()
+{
+    Json::Value doc;
+    doc["user_id"] = "a1b2c3d4e5f60718";
+    doc["nickname"] = "小明同学";
+    doc["phone"] = "15700000000";
+    doc["description"] = "这个人很懒，什么都没有留下 \"签名\"";
+    doc["avatar_id"] = "f0e1d2c3b4a59687";
+    return doc;
+}
+
+Json::Value messageDocument()
+{
+    Json::Value doc;
+    doc["message_id"] = "7f3a9c2e1b4d5a60";
+    doc["chat_session_id"] = "session-00012345";
+    doc["user_id"] = "a1b2c3d4e5f60718";
+    doc["create_time"] = (Json::Int64)1729300000;
+    doc["content"] = "今天晚上一起去吃火锅吗？\n地点还是老地方，七点见，不见不散！Let's go~";
+    return doc;
+}
+
+// 搜索请求体，包含嵌套对象和数组
+Json::Value searchDocument()
+{
+    Json::Value must_not;
+    for(int i = 0; i < 20; ++i)
+        must_not["terms"]["user_id.keyword"].append("friend-" + std::to_string(i));
+    Json::Value should;
+    for(const char* key : {"user_id.keyword", "nickname", "phone.keyword"})
+    {
+        Json::Value match;
+        match["match"][key] = "小明";
+        should.append(match);
+    }
+    Json::Value root;
+    root["query"]["bool"]["must_not"].append(must_not);
+    root["query"]["bool"]["should"] = should;
+    root["size"] = 20;
+    root["boost"] = 1.5;
+    return root;
+}
+
+template<typename Func>
+double measure(size_t count, Func&& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < count; ++i)
+        func();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+void run(const char* name, const Json::Value& doc, size_t count)
+{
+    std::string legacy, cached, fast;
+    legacySerialize(doc, legacy);
+    hmy::JsonStreamCodec::write(doc, cached);
+    hmy::JsonFastWriter::write(doc, fast);
+    if(cached != fast)
+    {
+        fprintf(stderr, "%s: JsonFastWriter 输出与 jsoncpp 不一致\n%s\n%s\n", name, cached.c_str(), fast.c_str());
+        exit(1);
+    }
+
+    std::string out;
+    Json::Value val;
+    double legacy_write = measure(count, [&](){ legacySerialize(doc, out); });
+    double cached_write = measure(count, [&](){ hmy::JsonStreamCodec::write(doc, out); });
+    double fast_write = measure(count, [&](){ hmy::JsonFastWriter::write(doc, out); });
+    double legacy_read = measure(count, [&](){ legacyUnSerialize(cached, val); });
+    double cached_read = measure(count, [&](){ hmy::UnSerialize(cached, val); });
+    printf("%-8s %6zu %12.0f %12.0f %12.0f %12.0f %12.0f\n", name, cached.size(),
+        legacy_write, cached_write, fast_write, legacy_read, cached_read);
+}
+}
+
+int main(int argc, char* argv[])
+{
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    printf("%-8s %6s %12s %12s %12s %12s %12s\n", "doc", "bytes", "legacy_w(ns)", "cached_w(ns)", "fast_w(ns)", "legacy_r(ns)", "cached_r(ns)");
+    run("user", userDocument(), count);
+    run("message", messageDocument(), count);
+    run("search", searchDocument(), count);
+    return 0;
+}
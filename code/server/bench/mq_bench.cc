@@ -0,0 +1,94 @@
+// MQClient 发布 -> 消费往返压测
+// 使用进程内的 AMQP 替身服务器，不依赖 RabbitMQ；按消息大小、是否批量、消费者数量组合测试，
+// 输出吞吐(条/秒)与端到端延迟分位数
+// 用法: mq_bench [每组消息条数，默认 100000]
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+#include "amqp_standin.hpp"
+#include "../common/rabbitmq.hpp"
+
+namespace {
+int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void run(size_t count, size_t payload, bool batch, size_t consumers)
+{
+    const size_t window = 10000; // 最多同时在途的消息条数，避免发布端无限堆积
+    std::string spill_dir = (std::filesystem::temp_directory_path() / "mq_bench_spill").string();
+    std::filesystem::remove_all(spill_dir);
+
+    hmy::AMQPStandin server;
+    hmy::MQClient client("guest", "guest", "127.0.0.1:" + std::to_string(server.port()), spill_dir);
+    if(batch)
+        client.enableBatch();
+    client.declareComponents("bench_exchange", "bench_queue");
+
+    std::vector<int64_t> latencies(count);
+    std::atomic<size_t> received(0);
+    std::atomic<bool> warmed(false);
+    for(size_t i = 0; i < consumers; ++i)
+    {
+        client.consume("bench_queue", "bench_consumer_" + std::to_string(i), [&](const char* body, size_t size){
+            if(!warmed.load(std::memory_order_acquire))
+            {
+                warmed.store(true, std::memory_order_release);
+                return;
+            }
+            int64_t sent;
+            memcpy(&sent, body, sizeof(sent));
+            size_t idx = received.load(std::memory_order_relaxed);
+            if(idx < count)
+                latencies[idx] = now_ns() - sent;
+            received.store(idx + 1, std::memory_order_release);
+        });
+    }
+
+    // 预热：等待连接建立、拓扑声明完成
+    std::string msg(std::max(payload, sizeof(int64_t)), 'x');
+    client.publish("bench_exchange", msg);
+    while(!warmed.load(std::memory_order_acquire))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    int64_t start = now_ns();
+    for(size_t i = 0; i < count; ++i)
+    {
+        while(i - received.load(std::memory_order_acquire) >= window)
+            std::this_thread::yield();
+        int64_t sent = now_ns();
+        memcpy(msg.data(), &sent, sizeof(sent));
+        client.publish("bench_exchange", msg);
+    }
+    while(received.load(std::memory_order_acquire) < count)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    double seconds = (now_ns() - start) / 1e9;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p){
+        return latencies[std::min(count - 1, (size_t)(p * count))] / 1000.0;
+    };
+    printf("%8zu %6s %9zu %12.0f %10.1f %10.1f %10.1f %10.1f\n", payload, batch ? "on" : "off", consumers,
+        count / seconds, percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999));
+}
+}
+
+int main(int argc, char* argv[])
+{
+    hmy::init_logger(true, "mq_bench.log", spdlog::level::warn);
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    printf("%8s %6s %9s %12s %10s %10s %10s %10s\n", "payload", "batch", "consumers", "msg/s", "p50(us)", "p90(us)", "p99(us)", "p999(us)");
+    for(size_t payload : {64, 512, 4096, 65536})
+    {
+        for(bool batch : {false, true})
+        {
+            for(size_t consumers : {1, 4})
+                run(count, payload, batch, consumers);
+        }
+    }
+    return 0;
+}
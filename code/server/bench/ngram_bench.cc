@@ -0,0 +1,142 @@
+// NgramIndex 好友范围搜索压测
+// 随机生成用户(中文昵称 + 用户ID + 手机号)和好友关系，对比在好友范围内逐个做子串匹配与 NgramIndex 的查询延迟，
+// 并校验两者结果一致；NgramIndex 使用 SIMD 交集需以 -mssse3 或 -march=native 编译
+// 另有一个成员为 1/16 用户的大群，用任意用户的完整昵称查询，倒排表比范围短
+// 用法: ngram_bench [用户数，默认 1000000] [每人好友数，默认 300]
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include "../common/ngram_index.hpp"
+
+namespace {
+const char* CHARS[] = {"小", "明", "红", "张", "王", "李", "伟", "芳", "娜", "静", "丽", "强", "磊", "军", "洋", "勇", "艳", "杰", "娟", "涛",
+    "超", "霞", "平", "刚", "桂", "英", "华", "飞", "鹏", "晨", "宇", "欣", "雨", "萱", "子", "轩", "浩", "然", "梓", "涵"};
+
+struct User
+{
+    std::string id;
+    std::vector<std::string> fields;
+};
+
+std::vector<User> makeUsers(size_t count, std::mt19937& rng)
+{
+    std::vector<User> users(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        std::string nickname;
+        size_t len = 2 + rng() % 4;
+        for(size_t c = 0; c < len; ++c)
+            nickname += CHARS[rng() % (sizeof(CHARS) / sizeof(CHARS[0]))];
+        char id[32], phone[16];
+        snprintf(id, sizeof(id), "u%08zx", i);
+        snprintf(phone, sizeof(phone), "1%010u", (unsigned)(rng() % 10000000000ULL));
+        users[i].id = id;
+        users[i].fields = {nickname, id, phone};
+    }
+    return users;
+}
+
+double nowUs()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+int main(int argc, char* argv[])
+{
+    size_t user_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t friend_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 300;
+    const size_t scopes = 1000, queries_per_scope = 20;
+    std::mt19937 rng(42);
+    std::vector<User> users = makeUsers(user_count, rng);
+
+    hmy::NgramIndex index;
+    double start = nowUs();
+    for(const auto& user : users)
+        index.upsert(user.id, user.fields);
+    printf("索引 %zu 个用户耗时 %.0f ms\n", user_count, (nowUs() - start) / 1000);
+
+    std::vector<std::vector<size_t>> friends(scopes);
+    for(size_t s = 0; s < scopes; ++s)
+    {
+        for(size_t f = 0; f < friend_count; ++f)
+        {
+            size_t u = rng() % user_count;
+            friends[s].push_back(u);
+            index.addToScope(users[s].id, users[u].id);
+        }
+        // 与 NgramIndex 一样按加入顺序返回，且同一好友只算一次
+        std::sort(friends[s].begin(), friends[s].end());
+        friends[s].erase(std::unique(friends[s].begin(), friends[s].end()), friends[s].end());
+    }
+    const std::string group = "group";
+    std::vector<size_t> group_members;
+    for(size_t u = 0; u < user_count; u += 16)
+    {
+        group_members.push_back(u);
+        index.addToScope(group, users[u].id);
+    }
+
+    double scan_us = 0, index_us = 0;
+    size_t hits = 0, total = 0;
+    // 在 members 范围内逐个做子串匹配，与 NgramIndex 的结果比较并计时
+    auto check = [&](const std::string& query, const std::string& scope, const std::vector<size_t>& members){
+        double t0 = nowUs();
+        std::vector<std::string> expect;
+        for(size_t u : members)
+        {
+            for(const auto& field : users[u].fields)
+            {
+                if(field.find(query) != std::string::npos)
+                {
+                    expect.push_back(users[u].id);
+                    break;
+                }
+            }
+        }
+        double t1 = nowUs();
+        std::vector<std::string> got = index.search(query, scope, SIZE_MAX);
+        double t2 = nowUs();
+        if(got != expect)
+        {
+            fprintf(stderr, "结果不一致: 查询 %s, 期望 %zu 条, 实际 %zu 条\n", query.c_str(), expect.size(), got.size());
+            return false;
+        }
+        scan_us += t1 - t0;
+        index_us += t2 - t1;
+        hits += got.size();
+        ++total;
+        return true;
+    };
+
+    printf("%-8s %10s %12s %12s\n", "query", "hits/q", "scan(us)", "index(us)");
+    for(size_t len : {1, 2, 3})
+    {
+        scan_us = index_us = 0;
+        hits = total = 0;
+        for(size_t s = 0; s < scopes; ++s)
+        {
+            for(size_t q = 0; q < queries_per_scope; ++q)
+            {
+                // 取某个好友昵称中的一段作为查询
+                const std::string& nickname = users[friends[s][rng() % friends[s].size()]].fields[0];
+                size_t chars = nickname.size() / 3;
+                size_t begin = rng() % (chars - std::min(len, chars) + 1);
+                std::string query = nickname.substr(begin * 3, std::min(len, chars) * 3);
+                if(check(query, users[s].id, friends[s]) == false)
+                    return 1;
+            }
+        }
+        printf("%zu chars  %10.1f %12.2f %12.2f\n", len, (double)hits / total, scan_us / total, index_us / total);
+    }
+
+    scan_us = index_us = 0;
+    hits = total = 0;
+    for(size_t q = 0; q < queries_per_scope * 10; ++q)
+    {
+        if(check(users[rng() % user_count].fields[0], group, group_members) == false)
+            return 1;
+    }
+    printf("%-8s %10.1f %12.2f %12.2f\n", "group", (double)hits / total, scan_us / total, index_us / total);
+    return 0;
+}
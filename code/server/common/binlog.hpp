@@ -0,0 +1,484 @@
+#pragma once
+#include <spdlog/common.h>
+#include <fmt/format.h>
+#include <fmt/args.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// 二进制日志
+// 每个日志调用点首次执行时登记一次 (等级, 格式串, 参数类型)，之后每条日志只写入
+// 调用点 ID、纳秒时间戳和参数的原始字节，不做任何格式化，由 binlog_decode 离线还原为文本
+//
+// 文件格式：文件头 "HMYBLOG1"，之后是若干数据块，每块以 1 字节类型开头
+//   BLOCK_SITE : u32 调用点ID | u8 等级 | u32 格式串长度 | 格式串 | u32 参数个数 | 参数类型码
+//   BLOCK_CHUNK: u32 线程ID | u32 数据长度 | 数据(连续的日志记录: u32 调用点ID | i64 时间戳 | 参数...)
+// 参数类型码：b-bool c-char i-int64 u-uint64 d-double s-字符串(u32 长度 + 字节)，其他类型先格式化为字符串
+namespace hmy{
+// 二进制日志的编码规则，BinLog 与 FlightRecorder 共用，BinLogDecoder 按同样的规则解码
+class BinLogCodec
+{
+public:
+    static constexpr char MAGIC[] = "HMYBLOG1";
+    static constexpr uint8_t BLOCK_SITE = 1;
+    static constexpr uint8_t BLOCK_CHUNK = 2;
+
+    struct Site
+    {
+        spdlog::level::level_enum level;
+        std::string format;
+        std::string codes;
+    };
+
+    template<typename T>
+    static constexpr char argCode()
+    {
+        if constexpr (std::is_same_v<T, bool>)
+            return 'b';
+        else if constexpr (std::is_same_v<T, char>)
+            return 'c';
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+            return 'i';
+        else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+            return 'u';
+        else if constexpr (std::is_floating_point_v<T>)
+            return 'd';
+        else
+            return 's';
+    }
+
+    template<typename T>
+    static void append(std::string& out, const T& val)
+    {
+        out.append((const char*)&val, sizeof(val));
+    }
+
+    static void appendString(std::string& out, std::string_view val)
+    {
+        append(out, (uint32_t)val.size());
+        out.append(val.data(), val.size());
+    }
+
+    template<typename T>
+    static void encode(std::string& out, const T& val)
+    {
+        using Type = std::decay_t<T>;
+        constexpr char code = argCode<Type>();
+        if constexpr (code == 'b' || code == 'c')
+            append(out, (uint8_t)val);
+        else if constexpr (code == 'i')
+            append(out, (int64_t)val);
+        else if constexpr (code == 'u')
+            append(out, (uint64_t)val);
+        else if constexpr (code == 'd')
+            append(out, (double)val);
+        else if constexpr (std::is_same_v<Type, const char*> || std::is_same_v<Type, char*>)
+            appendString(out, val ? std::string_view(val) : std::string_view("(null)"));
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+            appendString(out, std::string_view(val));
+        else
+            appendString(out, fmt::format("{}", val));
+    }
+
+    // 参数类型码串，每个参数类型组合只生成一份
+    template<typename... Args>
+    static const char* argCodes()
+    {
+        static const char codes[] = {argCode<std::decay_t<Args>>()..., '\0'};
+        return codes;
+    }
+
+    static std::string siteBlock(uint32_t id, const Site& site)
+    {
+        std::string block;
+        append(block, BLOCK_SITE);
+        append(block, id);
+        append(block, (uint8_t)site.level);
+        appendString(block, site.format);
+        appendString(block, site.codes);
+        return block;
+    }
+};
+
+class BinLog
+{
+public:
+    using ptr = std::shared_ptr<BinLog>;
+    BinLog(const std::string& file, int32_t level, size_t buffer_size = 64 * 1024, int flush_interval_ms = 1000)
+    : _level((spdlog::level::level_enum)level)
+    , _buffer_size(buffer_size)
+    , _flush_interval(flush_interval_ms)
+    , _instance(nextInstance())
+    , _stop(false)
+    {
+        _file = fopen(file.c_str(), "ab");
+        if(_file == nullptr)
+        {
+            std::cerr << "打开二进制日志文件 " << file << " 失败: " << strerror(errno) << std::endl;
+            return;
+        }
+        fwrite(BinLogCodec::MAGIC, 1, sizeof(BinLogCodec::MAGIC) - 1, _file);
+        // 之前的实例已登记过的调用点不会再次登记，需要在新文件中重新写出定义
+        {
+            std::unique_lock lock(siteMutex());
+            for(size_t i = 0; i < sites().size(); ++i)
+                _queue.push_back(BinLogCodec::siteBlock(i + 1, sites()[i]));
+        }
+        _flusher = std::thread(&BinLog::flushLoop, this);
+    }
+
+    ~BinLog()
+    {
+        {
+            std::unique_lock lock(_queue_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        if(_flusher.joinable())
+            _flusher.join();
+        if(_file)
+            fclose(_file);
+    }
+
+    bool should_log(spdlog::level::level_enum level) const
+    {
+        return _file != nullptr && level >= _level;
+    }
+
+    template<typename... Args>
+    void write(std::atomic<uint32_t>& site, spdlog::level::level_enum level, const char* format, const Args&... args)
+    {
+        uint32_t id = site.load(std::memory_order_acquire);
+        if(id == 0)
+        {
+            id = registerSite(site, level, format, BinLogCodec::argCodes<Args...>());
+        }
+        int64_t ts = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        ThreadBuffer& buffer = threadBuffer();
+        std::unique_lock lock(buffer.mutex);
+        BinLogCodec::append(buffer.data, id);
+        BinLogCodec::append(buffer.data, ts);
+        (BinLogCodec::encode(buffer.data, args), ...);
+        if(buffer.data.size() >= _buffer_size)
+            submit(buffer);
+    }
+private:
+    // 每个线程独占的记录缓冲区，写满后整块交给后台线程写文件
+    struct ThreadBuffer
+    {
+        std::mutex mutex;
+        std::string data;
+        uint32_t tid;
+        std::atomic<bool> exited{false};
+    };
+    struct ThreadBufferHolder
+    {
+        std::shared_ptr<ThreadBuffer> buffer;
+        uint64_t instance = 0;
+        ~ThreadBufferHolder()
+        {
+            if(buffer)
+                buffer->exited = true;
+        }
+    };
+
+    static uint64_t nextInstance()
+    {
+        static std::atomic<uint64_t> seq(0);
+        return ++seq;
+    }
+
+    // 调用点登记表在进程内全局唯一，调用点 ID 即下标 + 1
+    static std::mutex& siteMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+    static std::vector<BinLogCodec::Site>& sites()
+    {
+        static std::vector<BinLogCodec::Site> sites;
+        return sites;
+    }
+
+    uint32_t registerSite(std::atomic<uint32_t>& site, spdlog::level::level_enum level, const char* format, const char* codes)
+    {
+        std::unique_lock lock(siteMutex());
+        uint32_t id = site.load(std::memory_order_relaxed);
+        if(id != 0)
+            return id;
+        sites().push_back(BinLogCodec::Site{level, format, codes});
+        id = sites().size();
+        {
+            // 定义块先于任何引用它的记录进入写出队列
+            std::unique_lock queue_lock(_queue_mutex);
+            _queue.push_back(BinLogCodec::siteBlock(id, sites().back()));
+        }
+        site.store(id, std::memory_order_release);
+        return id;
+    }
+
+    ThreadBuffer& threadBuffer()
+    {
+        thread_local ThreadBufferHolder holder;
+        if(holder.instance != _instance)
+        {
+            if(holder.buffer)
+                holder.buffer->exited = true;
+            holder.buffer = std::make_shared<ThreadBuffer>();
+            holder.buffer->tid = syscall(SYS_gettid);
+            holder.buffer->data.reserve(_buffer_size);
+            holder.instance = _instance;
+            std::unique_lock lock(_buffers_mutex);
+            _buffers.push_back(holder.buffer);
+        }
+        return *holder.buffer;
+    }
+
+    // 调用时必须持有 buffer.mutex，保证同一线程的数据块按顺序进入队列
+    void submit(ThreadBuffer& buffer)
+    {
+        if(buffer.data.empty())
+            return;
+        std::string block;
+        block.reserve(buffer.data.size() + 9);
+        BinLogCodec::append(block, BinLogCodec::BLOCK_CHUNK);
+        BinLogCodec::append(block, buffer.tid);
+        BinLogCodec::append(block, (uint32_t)buffer.data.size());
+        block.append(buffer.data);
+        buffer.data.clear();
+        {
+            std::unique_lock lock(_queue_mutex);
+            _queue.push_back(std::move(block));
+        }
+        _cond.notify_one();
+    }
+
+    // 收集所有线程缓冲区中尚未写满的数据，并清理已退出线程的缓冲区
+    void drain()
+    {
+        std::unique_lock lock(_buffers_mutex);
+        for(auto it = _buffers.begin(); it != _buffers.end();)
+        {
+            bool exited = (*it)->exited;
+            {
+                std::unique_lock buffer_lock((*it)->mutex);
+                submit(**it);
+            }
+            it = exited ? _buffers.erase(it) : it + 1;
+        }
+    }
+
+    void flushLoop()
+    {
+        auto last_drain = std::chrono::steady_clock::now();
+        while(true)
+        {
+            bool stop;
+            {
+                std::unique_lock lock(_queue_mutex);
+                _cond.wait_for(lock, _flush_interval, [this](){ return _stop || !_queue.empty(); });
+                stop = _stop;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if(stop || now - last_drain >= _flush_interval)
+            {
+                drain();
+                last_drain = now;
+            }
+            std::deque<std::string> blocks;
+            {
+                std::unique_lock lock(_queue_mutex);
+                blocks.swap(_queue);
+            }
+            for(const auto& block : blocks)
+                fwrite(block.data(), 1, block.size(), _file);
+            fflush(_file);
+            if(stop)
+                return;
+        }
+    }
+
+private:
+    spdlog::level::level_enum _level;
+    size_t _buffer_size; // 单个线程缓冲区写满后提交的阈值
+    std::chrono::milliseconds _flush_interval; // 未写满的缓冲区定期提交的间隔
+    uint64_t _instance; // 区分不同实例的线程缓冲区
+    FILE* _file;
+
+    std::mutex _buffers_mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> _buffers;
+
+    std::mutex _queue_mutex;
+    std::condition_variable _cond;
+    bool _stop;
+    std::deque<std::string> _queue; // 待写入文件的数据块
+    std::thread _flusher;
+};
+
+// 二进制日志解码，输出格式与文本日志相同："[default-logger][时:分:秒][线程][等级]内容"
+// 记录按文件中数据块的顺序输出，同一线程内有序
+class BinLogDecoder
+{
+public:
+    bool decode(const std::string& file, std::ostream& out)
+    {
+        std::ifstream in(file, std::ios::binary);
+        if(!in.is_open())
+        {
+            std::cerr << "打开二进制日志文件 " << file << " 失败" << std::endl;
+            return false;
+        }
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const size_t magic_len = sizeof(BinLogCodec::MAGIC) - 1;
+        size_t pos = 0;
+        while(pos < data.size())
+        {
+            // 同一文件可能被多次打开追加，中间会再次出现文件头
+            if(data.compare(pos, magic_len, BinLogCodec::MAGIC) == 0)
+            {
+                pos += magic_len;
+                continue;
+            }
+            uint8_t type = data[pos++];
+            if(type == BinLogCodec::BLOCK_SITE)
+            {
+                uint32_t id;
+                uint8_t level;
+                std::string format, codes;
+                if(!read(data, pos, id) || !read(data, pos, level) || !readString(data, pos, format) || !readString(data, pos, codes))
+                    return truncated(file);
+                if(_sites.size() < id)
+                    _sites.resize(id);
+                _sites[id - 1] = BinLogCodec::Site{(spdlog::level::level_enum)level, format, codes};
+            }
+            else if(type == BinLogCodec::BLOCK_CHUNK)
+            {
+                uint32_t tid, len;
+                if(!read(data, pos, tid) || !read(data, pos, len) || data.size() - pos < len)
+                    return truncated(file);
+                if(!decodeChunk(std::string_view(data).substr(pos, len), tid, out))
+                {
+                    std::cerr << file << ": 数据块解析失败，跳过" << std::endl;
+                }
+                pos += len;
+            }
+            else
+            {
+                std::cerr << file << ": 未知的数据块类型 " << (int)type << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+private:
+
+    template<typename T>
+    static bool read(std::string_view data, size_t& pos, T& val)
+    {
+        if(data.size() - pos < sizeof(T))
+            return false;
+        memcpy(&val, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    static bool readString(std::string_view data, size_t& pos, std::string& val)
+    {
+        uint32_t len;
+        if(!read(data, pos, len) || data.size() - pos < len)
+            return false;
+        val.assign(data.data() + pos, len);
+        pos += len;
+        return true;
+    }
+
+    bool truncated(const std::string& file)
+    {
+        std::cerr << file << ": 文件末尾的数据块不完整" << std::endl;
+        return false;
+    }
+
+    bool decodeChunk(std::string_view chunk, uint32_t tid, std::ostream& out)
+    {
+        size_t pos = 0;
+        while(pos < chunk.size())
+        {
+            uint32_t id;
+            int64_t ts;
+            if(!read(chunk, pos, id) || !read(chunk, pos, ts) || id == 0 || id > _sites.size())
+                return false;
+            const BinLogCodec::Site& site = _sites[id - 1];
+            fmt::dynamic_format_arg_store<fmt::format_context> store;
+            for(char code : site.codes)
+            {
+                if(code == 'b' || code == 'c')
+                {
+                    uint8_t v;
+                    if(!read(chunk, pos, v))
+                        return false;
+                    if(code == 'b')
+                        store.push_back((bool)v);
+                    else
+                        store.push_back((char)v);
+                }
+                else if(code == 'i' || code == 'u' || code == 'd')
+                {
+                    int64_t raw;
+                    if(!read(chunk, pos, raw))
+                        return false;
+                    if(code == 'i')
+                        store.push_back(raw);
+                    else if(code == 'u')
+                        store.push_back((uint64_t)raw);
+                    else
+                    {
+                        double v;
+                        memcpy(&v, &raw, sizeof(v));
+                        store.push_back(v);
+                    }
+                }
+                else
+                {
+                    std::string v;
+                    if(!readString(chunk, pos, v))
+                        return false;
+                    store.push_back(std::move(v));
+                }
+            }
+            std::string msg;
+            try
+            {
+                msg = fmt::vformat(site.format, store);
+            }
+            catch(const std::exception& e)
+            {
+                msg = site.format + " <格式化失败: " + e.what() + ">";
+            }
+            time_t sec = ts / 1000000000;
+            std::tm tm;
+            localtime_r(&sec, &tm);
+            auto level = spdlog::level::to_string_view(site.level);
+            out << fmt::format("[default-logger][{:02}:{:02}:{:02}][{}][{:<8}]{}\n", tm.tm_hour, tm.tm_min, tm.tm_sec, tid,
+                std::string_view(level.data(), level.size()), msg);
+        }
+        return true;
+    }
+
+private:
+    std::vector<BinLogCodec::Site> _sites; // 调用点 ID - 1 -> 调用点定义
+};
+}
@@ -1,9 +1,88 @@
 #pragma once
 #include <brpc/channel.h>
+#include <brpc/controller.h>
+#include <bthread/bthread.h>
 #include "logger.hpp"
 
 // 1. 封装单个服务的信道管理类
 namespace hmy{
+// RPC 处理函数运行在 bthread 上，bthread 阻塞后可能换到其他工作线程继续执行，追踪上下文要放在 bthread 局部存储中
+// 在普通线程中调用时 bthread_getspecific 使用线程局部的存储，同样适用
+// 只在 create 为 true(进入追踪作用域)时分配上下文，普通日志调用只做查找
+inline TraceContext* bthreadTraceContext(bool create)
+{
+    static bthread_key_t key = [](){
+        bthread_key_t key;
+        bthread_key_create(&key, [](void* ctx){ delete static_cast<TraceContext*>(ctx); });
+        return key;
+    }();
+    TraceContext* ctx = static_cast<TraceContext*>(bthread_getspecific(key));
+    if(ctx == nullptr && create)
+    {
+        ctx = new TraceContext();
+        bthread_setspecific(key, ctx);
+    }
+    return ctx;
+}
+static const bool g_bthread_trace_installed = (Trace::setStorage(&bthreadTraceContext), true);
+
+// 发起调用时把当前追踪 ID 写入请求元数据的 log_id，并为这次调用记录一个 span
+// 异步调用的 span 在完成回调中结束
+class TracedChannel : public brpc::Channel
+{
+public:
+    void CallMethod(const google::protobuf::MethodDescriptor* method, google::protobuf::RpcController* controller,
+        const google::protobuf::Message* request, google::protobuf::Message* response, google::protobuf::Closure* done) override
+    {
+        const TraceContext& ctx = Trace::current();
+        if(ctx.trace_id == 0)
+        {
+            brpc::Channel::CallMethod(method, controller, request, response, done);
+            return;
+        }
+        static_cast<brpc::Controller*>(controller)->set_log_id(ctx.trace_id);
+        if(done == nullptr)
+        {
+            TraceScope scope(method->full_name());
+            brpc::Channel::CallMethod(method, controller, request, response, done);
+            return;
+        }
+        if(g_trace_exporter && g_trace_exporter->sampled(ctx.trace_id))
+            done = new SpanClosure(ctx, method->full_name(), done);
+        brpc::Channel::CallMethod(method, controller, request, response, done);
+    }
+private:
+    class SpanClosure : public google::protobuf::Closure
+    {
+    public:
+        SpanClosure(const TraceContext& ctx, const std::string& name, google::protobuf::Closure* done)
+        : _trace_id(ctx.trace_id), _parent(ctx.span_id), _span(Trace::newId()), _name(name), _start(Trace::nowUs()), _done(done)
+        {}
+        void Run() override
+        {
+            g_trace_exporter->record(_trace_id, _span, _parent, _name, _start, Trace::nowUs() - _start);
+            _done->Run();
+            delete this;
+        }
+    private:
+        uint64_t _trace_id;
+        uint64_t _parent;
+        uint64_t _span;
+        std::string _name;
+        int64_t _start;
+        google::protobuf::Closure* _done;
+    };
+};
+
+// RPC 服务端在处理函数开头创建，从请求的 log_id 恢复追踪上下文，处理函数返回时记录 span
+// baidu_std 只能携带追踪 ID，服务端 span 的父 span 未知
+class RpcTraceScope : public TraceScope
+{
+public:
+    RpcTraceScope(brpc::Controller* cntl, std::string_view name)
+    : TraceScope(name, cntl->log_id())
+    {}
+};
 
 class ServiceChannel
 {
@@ -17,7 +96,7 @@ public:
     // 服务上线，调用 append 新增信道
     void append(const std::string& host)
     {
-        std::shared_ptr<brpc::Channel> channel = std::make_shared<brpc::Channel>();
+        std::shared_ptr<brpc::Channel> channel = std::make_shared<TracedChannel>();
         brpc::ChannelOptions options;
         options.connect_timeout_ms = -1; // 连接等待超时时间  -1表示一直等待
         options.timeout_ms= -1; // rpc 请求等待超时时间 -1表示一直等待
@@ -60,7 +139,7 @@ public:
         std::unique_lock lock(_mutex);
         if(_channels.size() == 0)
         {
-            LOG_ERROR("当前没有能够提供 {} 服务的节点！", _service_name);
+            LOG_ERROR_RL("当前没有能够提供 {} 服务的节点！", _service_name);
             return Channelptr();
         } 
         int32_t idx  = _index++ % _channels.size();
@@ -89,7 +168,7 @@ public:
         auto sit = _services.find(service_name);
         if(sit == _services.end())
         {
-            LOG_ERROR("当前没有能够提供 {} 服务的节点！", service_name);
+            LOG_ERROR_RL("当前没有能够提供 {} 服务的节点！", service_name);
             return ServiceChannel::Channelptr();
         }
         return sit->second->choose();
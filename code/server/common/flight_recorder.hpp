@@ -0,0 +1,392 @@
+#pragma once
+#include "binlog.hpp"
+#include <signal.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <ctime>
+#include <functional>
+
+// 飞行记录器
+// 生产环境不开 TRACE/DEBUG 日志，但出问题后需要最近几秒的细节：LOG_TRACE/LOG_DEBUG 无论日志等级如何，
+// 都以二进制记录(调用点 ID | 时间戳 | 参数原始字节，与 BinLog 相同)写入当前线程独占的环形缓冲区，不做格式化，
+// 缓冲区写满后覆盖最旧的记录。收到信号、进程崩溃或管理接口调用时，把所有线程缓冲区中的记录按时间排序转储为
+// BinLog 格式的文件，用 binlog_decode 还原为文本
+//
+// 每个槽位带一个序号(写入中为奇数，写完为偶数)，写线程只做原子存储，转储线程读取前后比较序号，
+// 读到被并发覆盖的槽位直接跳过，写入路径没有锁
+namespace hmy{
+class FlightRecorder
+{
+public:
+    using ptr = std::shared_ptr<FlightRecorder>;
+    static constexpr size_t SLOT_SIZE = 256; // 单条记录的最大字节数，超出的记录丢弃并计数
+
+    // slots_per_thread 向上取整为 2 的幂；已退出线程的缓冲区保留 max_exited_threads 个，超出时释放最早的
+    FlightRecorder(const std::string& dump_dir, size_t slots_per_thread = 1024, size_t max_exited_threads = 16)
+    : _dump_dir(dump_dir)
+    , _slots(roundUp(slots_per_thread))
+    , _max_exited(max_exited_threads)
+    , _instance(nextInstance())
+    , _oversized(0)
+    , _dump_seq(0)
+    {
+        _pipe[0] = _pipe[1] = -1;
+    }
+
+    ~FlightRecorder()
+    {
+        FlightRecorder* self = this;
+        target().compare_exchange_strong(self, nullptr);
+        if(_watcher.joinable())
+        {
+            char cmd = 'q';
+            (void)::write(_pipe[1], &cmd, 1);
+            _watcher.join();
+            sigaction(_watch_signal, &_old_action, nullptr);
+            close(_pipe[0]);
+            close(_pipe[1]);
+        }
+    }
+
+    template<typename... Args>
+    void record(std::atomic<uint32_t>& site, spdlog::level::level_enum level, const char* format, const Args&... args)
+    {
+        uint32_t id = site.load(std::memory_order_acquire);
+        if(id == 0)
+            id = registerSite(site, level, format, BinLogCodec::argCodes<Args...>());
+        thread_local std::string scratch;
+        scratch.clear();
+        BinLogCodec::append(scratch, id);
+        BinLogCodec::append(scratch, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        (BinLogCodec::encode(scratch, args), ...);
+        if(scratch.size() > SLOT_SIZE)
+        {
+            _oversized.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Ring& ring = threadRing();
+        uint64_t n = ring.next++;
+        Slot& slot = ring.slots[n & (_slots - 1)];
+        slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.size = scratch.size();
+        memcpy(slot.data, scratch.data(), scratch.size());
+        slot.seq.store(2 * n + 2, std::memory_order_release);
+    }
+
+    // 转储到 dump_dir 下的 flight-<pid>-<时间>.blog，返回文件路径，失败返回空串
+    std::string dump()
+    {
+        return dumpFile(true);
+    }
+
+    // 转储完成(信号或管理接口触发)后的回调，参数为文件路径；崩溃时不调用
+    void setDumpCallback(const std::function<void(const std::string&)>& cb)
+    {
+        _dump_cb = cb;
+    }
+
+    // 收到 signo 时转储，信号处理函数只向管道写一个字节，转储在后台线程中完成
+    bool watchSignal(int signo = SIGUSR2)
+    {
+        if(_watcher.joinable())
+            return false;
+        if(pipe2(_pipe, O_CLOEXEC) != 0)
+        {
+            std::cerr << "创建飞行记录器信号管道失败: " << strerror(errno) << std::endl;
+            return false;
+        }
+        target().store(this);
+        _watch_signal = signo;
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = &FlightRecorder::onDumpSignal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(signo, &action, &_old_action);
+        _watcher = std::thread(&FlightRecorder::watchLoop, this);
+        return true;
+    }
+
+    // 进程因 SIGSEGV/SIGABRT/SIGBUS/SIGFPE/SIGILL 崩溃时先转储再按默认方式退出(保留 core)
+    // 崩溃现场的转储是尽力而为：取不到锁的部分直接跳过，过程中会分配内存，并非严格的异步信号安全
+    void dumpOnCrash()
+    {
+        target().store(this);
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = &FlightRecorder::onCrashSignal;
+        action.sa_flags = SA_RESETHAND;
+        sigemptyset(&action.sa_mask);
+        for(int signo : {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL})
+            sigaction(signo, &action, nullptr);
+    }
+
+    // 在 httplib::Server 上挂载转储接口，POST 后返回转储文件路径
+    template<typename Server>
+    void mountDumpHandler(Server& server, const std::string& pattern = "/admin/flight_dump")
+    {
+        server.Post(pattern, [this](const auto& request, auto& response){
+            std::string path = dump();
+            if(path.empty())
+            {
+                response.status = 500;
+                response.set_content("转储失败", "text/plain; charset=utf-8");
+                return;
+            }
+            response.set_content(path, "text/plain; charset=utf-8");
+        });
+    }
+
+    // 因超过 SLOT_SIZE 被丢弃的记录条数
+    size_t oversized() const
+    {
+        return _oversized.load(std::memory_order_relaxed);
+    }
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> seq{0}; // 0--空，奇数--写入中，偶数--第 seq/2 条记录已写完
+        uint32_t size = 0;
+        char data[SLOT_SIZE];
+    };
+    // 每个线程独占的环形缓冲区，只有所属线程写入
+    struct Ring
+    {
+        uint32_t tid;
+        std::atomic<bool> exited{false};
+        uint64_t next = 0;
+        std::unique_ptr<Slot[]> slots;
+    };
+    struct RingHolder
+    {
+        std::shared_ptr<Ring> ring;
+        uint64_t instance = 0;
+        ~RingHolder()
+        {
+            if(ring)
+                ring->exited = true;
+        }
+    };
+    struct Record
+    {
+        int64_t ts;
+        uint32_t tid;
+        std::string data;
+    };
+
+    static size_t roundUp(size_t n)
+    {
+        size_t size = 1;
+        while(size < n)
+            size <<= 1;
+        return size;
+    }
+
+    static uint64_t nextInstance()
+    {
+        static std::atomic<uint64_t> seq(0);
+        return ++seq;
+    }
+
+    // 调用点登记表独立于 BinLog，转储时全部写出
+    static std::mutex& siteMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+    static std::vector<BinLogCodec::Site>& sites()
+    {
+        static std::vector<BinLogCodec::Site> sites;
+        return sites;
+    }
+
+    static uint32_t registerSite(std::atomic<uint32_t>& site, spdlog::level::level_enum level, const char* format, const char* codes)
+    {
+        std::unique_lock lock(siteMutex());
+        uint32_t id = site.load(std::memory_order_relaxed);
+        if(id != 0)
+            return id;
+        sites().push_back(BinLogCodec::Site{level, format, codes});
+        id = sites().size();
+        site.store(id, std::memory_order_release);
+        return id;
+    }
+
+    // 信号处理函数通过它找到需要转储的实例
+    static std::atomic<FlightRecorder*>& target()
+    {
+        static std::atomic<FlightRecorder*> recorder(nullptr);
+        return recorder;
+    }
+
+    static void onDumpSignal(int)
+    {
+        FlightRecorder* self = target().load();
+        if(self)
+        {
+            int saved = errno;
+            char cmd = 'd';
+            (void)::write(self->_pipe[1], &cmd, 1);
+            errno = saved;
+        }
+    }
+
+    static void onCrashSignal(int signo)
+    {
+        static std::atomic<bool> entered(false);
+        FlightRecorder* self = target().load();
+        if(self && !entered.exchange(true))
+            self->dumpFile(false);
+        // SA_RESETHAND 已恢复默认处理，返回后重新投递的信号按默认方式终止进程
+        raise(signo);
+    }
+
+    void watchLoop()
+    {
+        char cmd;
+        while(true)
+        {
+            ssize_t ret = ::read(_pipe[0], &cmd, 1);
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret <= 0 || cmd == 'q')
+                return;
+            dump();
+        }
+    }
+
+    Ring& threadRing()
+    {
+        thread_local RingHolder holder;
+        if(holder.instance != _instance)
+        {
+            if(holder.ring)
+                holder.ring->exited = true;
+            holder.ring = std::make_shared<Ring>();
+            holder.ring->tid = syscall(SYS_gettid);
+            holder.ring->slots.reset(new Slot[_slots]);
+            holder.instance = _instance;
+            std::unique_lock lock(_rings_mutex);
+            size_t exited = std::count_if(_rings.begin(), _rings.end(), [](const auto& ring){ return ring->exited.load(); });
+            for(auto it = _rings.begin(); it != _rings.end() && exited > _max_exited;)
+            {
+                if((*it)->exited)
+                {
+                    it = _rings.erase(it);
+                    --exited;
+                }
+                else
+                    ++it;
+            }
+            _rings.push_back(holder.ring);
+        }
+        return *holder.ring;
+    }
+
+    // blocking 为 false 时(崩溃现场)取不到锁就跳过对应部分，避免与崩溃前持锁的线程死锁
+    std::string dumpFile(bool blocking)
+    {
+        char name[64];
+        time_t now = time(nullptr);
+        struct tm tm;
+        localtime_r(&now, &tm);
+        size_t len = strftime(name, sizeof(name), "%Y%m%d-%H%M%S", &tm);
+        snprintf(name + len, sizeof(name) - len, "-%lu.blog", (unsigned long)_dump_seq.fetch_add(1));
+        std::string path = _dump_dir + "/flight-" + std::to_string(getpid()) + "-" + name;
+
+        std::string data(BinLogCodec::MAGIC, sizeof(BinLogCodec::MAGIC) - 1);
+        std::unique_lock site_lock(siteMutex(), std::defer_lock);
+        if(blocking ? (site_lock.lock(), true) : site_lock.try_lock())
+        {
+            for(size_t i = 0; i < sites().size(); ++i)
+                data.append(BinLogCodec::siteBlock(i + 1, sites()[i]));
+            site_lock.unlock();
+        }
+        for(const auto& record : collect(blocking))
+        {
+            BinLogCodec::append(data, BinLogCodec::BLOCK_CHUNK);
+            BinLogCodec::append(data, record.tid);
+            BinLogCodec::append(data, (uint32_t)record.data.size());
+            data.append(record.data);
+        }
+
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(fd < 0)
+        {
+            if(blocking)
+                std::cerr << "创建飞行记录转储文件 " << path << " 失败: " << strerror(errno) << std::endl;
+            return "";
+        }
+        for(size_t off = 0; off < data.size();)
+        {
+            ssize_t ret = ::write(fd, data.data() + off, data.size() - off);
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret <= 0)
+                break;
+            off += ret;
+        }
+        close(fd);
+        if(blocking && _dump_cb)
+            _dump_cb(path);
+        return path;
+    }
+
+    // 读取所有线程缓冲区中写完的记录，按时间戳排序
+    std::vector<Record> collect(bool blocking)
+    {
+        std::vector<std::shared_ptr<Ring>> rings;
+        {
+            std::unique_lock lock(_rings_mutex, std::defer_lock);
+            if(blocking)
+                lock.lock();
+            else if(!lock.try_lock())
+                return {};
+            rings = _rings;
+        }
+        std::vector<Record> records;
+        char buf[SLOT_SIZE];
+        for(const auto& ring : rings)
+        {
+            for(size_t i = 0; i < _slots; ++i)
+            {
+                Slot& slot = ring->slots[i];
+                uint64_t seq = slot.seq.load(std::memory_order_acquire);
+                if(seq == 0 || (seq & 1))
+                    continue;
+                uint32_t size = std::min<uint32_t>(slot.size, SLOT_SIZE);
+                memcpy(buf, slot.data, size);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(slot.seq.load(std::memory_order_relaxed) != seq || size < sizeof(uint32_t) + sizeof(int64_t))
+                    continue;
+                Record record;
+                memcpy(&record.ts, buf + sizeof(uint32_t), sizeof(record.ts));
+                record.tid = ring->tid;
+                record.data.assign(buf, size);
+                records.push_back(std::move(record));
+            }
+        }
+        std::sort(records.begin(), records.end(), [](const Record& a, const Record& b){ return a.ts < b.ts; });
+        return records;
+    }
+
+private:
+    std::string _dump_dir;
+    size_t _slots; // 每个线程的槽位数，2 的幂
+    size_t _max_exited;
+    uint64_t _instance; // 区分不同实例的线程缓冲区
+    std::atomic<size_t> _oversized;
+    std::atomic<uint64_t> _dump_seq;
+    std::function<void(const std::string&)> _dump_cb;
+
+    std::mutex _rings_mutex;
+    std::vector<std::shared_ptr<Ring>> _rings;
+
+    int _pipe[2];
+    int _watch_signal = SIGUSR2;
+    struct sigaction _old_action;
+    std::thread _watcher;
+};
+}
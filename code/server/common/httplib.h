@@ -221,6 +221,7 @@ using socklen_t = int;
 #include <netinet/in.h>
 #ifdef __linux__
 #include <resolv.h>
+#include <sys/epoll.h>
 #endif
 #include <netinet/tcp.h>
 #ifdef CPPHTTPLIB_USE_POLL
@@ -1024,6 +1025,13 @@ public:
   Server &set_keep_alive_max_count(size_t count);
   Server &set_keep_alive_timeout(time_t sec);
 
+  // Event-driven mode (Linux only): connections are watched by an epoll loop
+  // on the listening thread and a worker from the task queue is used only
+  // while a request whose head has fully arrived is being served, so idle
+  // keep-alive connections don't occupy a thread. Has no effect on SSLServer
+  // or on other platforms.
+  Server &set_event_driven(bool on);
+
   Server &set_read_timeout(time_t sec, time_t usec = 0);
   template <class Rep, class Period>
   Server &set_read_timeout(const std::chrono::duration<Rep, Period> &duration);
@@ -1068,6 +1076,7 @@ protected:
   time_t idle_interval_sec_ = CPPHTTPLIB_IDLE_INTERVAL_SECOND;
   time_t idle_interval_usec_ = CPPHTTPLIB_IDLE_INTERVAL_USECOND;
   size_t payload_max_length_ = CPPHTTPLIB_PAYLOAD_MAX_LENGTH;
+  bool event_driven_ = false;
 
 private:
   using Handlers =
@@ -1087,6 +1096,9 @@ private:
                                 SocketOptions socket_options) const;
   int bind_internal(const std::string &host, int port, int socket_flags);
   bool listen_internal();
+#ifdef __linux__
+  bool listen_event_driven();
+#endif
 
   bool routing(Request &req, Response &res, Stream &strm);
   bool handle_file_request(const Request &req, Response &res,
@@ -1122,6 +1134,7 @@ private:
                          ContentReceiver multipart_receiver) const;
 
   virtual bool process_and_close_socket(socket_t sock);
+  virtual bool supports_event_driven() const;
 
   std::atomic<bool> is_running_{false};
   std::atomic<bool> is_decommissioned{false};
@@ -1981,6 +1994,7 @@ public:
 
 private:
   bool process_and_close_socket(socket_t sock) override;
+  bool supports_event_driven() const override;
 
   SSL_CTX *ctx_;
   std::mutex ctx_mutex_;
@@ -3436,6 +3450,63 @@ private:
 };
 #endif
 
+#ifdef __linux__
+// Stream used by the event-driven server. Bytes the event loop has already
+// read are consumed first; bytes read past the current request stay in the
+// connection buffer for the next one.
+class EventStream final : public Stream {
+public:
+  EventStream(socket_t sock, std::string &buffer, time_t read_timeout_sec,
+              time_t read_timeout_usec, time_t write_timeout_sec,
+              time_t write_timeout_usec);
+  ~EventStream() override;
+
+  bool is_readable() const override;
+  bool is_writable() const override;
+  ssize_t read(char *ptr, size_t size) override;
+  ssize_t write(const char *ptr, size_t size) override;
+  void get_remote_ip_and_port(std::string &ip, int &port) const override;
+  void get_local_ip_and_port(std::string &ip, int &port) const override;
+  socket_t socket() const override;
+  time_t duration() const override;
+
+private:
+  socket_t sock_;
+  std::string &buffer_;
+  size_t buffer_off_ = 0;
+  time_t read_timeout_sec_;
+  time_t read_timeout_usec_;
+  time_t write_timeout_sec_;
+  time_t write_timeout_usec_;
+  const std::chrono::time_point<std::chrono::steady_clock> start_time;
+
+  static const size_t read_buff_size_ = 1024l * 4;
+};
+
+struct EventConnection {
+  socket_t sock = INVALID_SOCKET;
+  std::string buffer; // Received but not yet consumed
+  size_t served = 0;  // Requests served on this connection
+  std::string remote_addr;
+  int remote_port = 0;
+  std::string local_addr;
+  int local_port = 0;
+  // Set by the event loop when the connection is handed to a worker and
+  // cleared by the worker before the connection is re-armed. A connection
+  // closed by a worker stays busy until the event loop releases it.
+  std::atomic<bool> busy{false};
+  std::chrono::steady_clock::time_point idle_since;
+};
+
+// The request head (request line and headers) has fully arrived, or the
+// buffered bytes are already too many to keep waiting in the event loop.
+inline bool has_request_head(const std::string &buffer) {
+  return buffer.find("\n\r\n") != std::string::npos ||
+         buffer.find("\n\n") != std::string::npos ||
+         buffer.size() >= CPPHTTPLIB_RECV_BUFSIZ;
+}
+#endif
+
 inline bool keep_alive(const std::atomic<socket_t> &svr_sock, socket_t sock,
                        time_t keep_alive_timeout_sec) {
   using namespace std::chrono;
@@ -6121,6 +6192,85 @@ inline time_t SocketStream::duration() const {
       .count();
 }
 
+#ifdef __linux__
+// Event stream implementation
+inline EventStream::EventStream(socket_t sock, std::string &buffer,
+                                time_t read_timeout_sec,
+                                time_t read_timeout_usec,
+                                time_t write_timeout_sec,
+                                time_t write_timeout_usec)
+    : sock_(sock), buffer_(buffer), read_timeout_sec_(read_timeout_sec),
+      read_timeout_usec_(read_timeout_usec),
+      write_timeout_sec_(write_timeout_sec),
+      write_timeout_usec_(write_timeout_usec),
+      start_time(std::chrono::steady_clock::now()) {}
+
+inline EventStream::~EventStream() { buffer_.erase(0, buffer_off_); }
+
+inline bool EventStream::is_readable() const {
+  return buffer_off_ < buffer_.size() ||
+         select_read(sock_, read_timeout_sec_, read_timeout_usec_) > 0;
+}
+
+inline bool EventStream::is_writable() const {
+  return select_write(sock_, write_timeout_sec_, write_timeout_usec_) > 0 &&
+         is_socket_alive(sock_);
+}
+
+inline ssize_t EventStream::read(char *ptr, size_t size) {
+  size = (std::min)(size,
+                    static_cast<size_t>((std::numeric_limits<ssize_t>::max)()));
+
+  if (buffer_off_ >= buffer_.size()) {
+    buffer_.clear();
+    buffer_off_ = 0;
+
+    if (!is_readable()) { return -1; }
+
+    if (size >= read_buff_size_) {
+      return read_socket(sock_, ptr, size, CPPHTTPLIB_RECV_FLAGS);
+    }
+
+    buffer_.resize(read_buff_size_);
+    auto n = read_socket(sock_, &buffer_[0], read_buff_size_,
+                         CPPHTTPLIB_RECV_FLAGS);
+    if (n <= 0) {
+      buffer_.clear();
+      return n;
+    }
+    buffer_.resize(static_cast<size_t>(n));
+  }
+
+  auto n = (std::min)(size, buffer_.size() - buffer_off_);
+  memcpy(ptr, buffer_.data() + buffer_off_, n);
+  buffer_off_ += n;
+  return static_cast<ssize_t>(n);
+}
+
+inline ssize_t EventStream::write(const char *ptr, size_t size) {
+  if (!is_writable()) { return -1; }
+  return send_socket(sock_, ptr, size, CPPHTTPLIB_SEND_FLAGS);
+}
+
+inline void EventStream::get_remote_ip_and_port(std::string &ip,
+                                                int &port) const {
+  return detail::get_remote_ip_and_port(sock_, ip, port);
+}
+
+inline void EventStream::get_local_ip_and_port(std::string &ip,
+                                               int &port) const {
+  return detail::get_local_ip_and_port(sock_, ip, port);
+}
+
+inline socket_t EventStream::socket() const { return sock_; }
+
+inline time_t EventStream::duration() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start_time)
+      .count();
+}
+#endif
+
 // Buffer stream implementation
 inline bool BufferStream::is_readable() const { return true; }
 
@@ -6456,6 +6606,11 @@ inline Server &Server::set_keep_alive_timeout(time_t sec) {
   return *this;
 }
 
+inline Server &Server::set_event_driven(bool on) {
+  event_driven_ = on;
+  return *this;
+}
+
 inline Server &Server::set_read_timeout(time_t sec, time_t usec) {
   read_timeout_sec_ = sec;
   read_timeout_usec_ = usec;
@@ -6904,6 +7059,12 @@ inline int Server::bind_internal(const std::string &host, int port,
 inline bool Server::listen_internal() {
   if (is_decommissioned) { return false; }
 
+#ifdef __linux__
+  if (event_driven_ && supports_event_driven()) {
+    return listen_event_driven();
+  }
+#endif
+
   auto ret = true;
   is_running_ = true;
   auto se = detail::scope_exit([&]() { is_running_ = false; });
@@ -6972,6 +7133,246 @@ inline bool Server::listen_internal() {
   return ret;
 }
 
+#ifdef __linux__
+inline bool Server::listen_event_driven() {
+  using namespace std::chrono;
+  using detail::EventConnection;
+
+  auto epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd < 0) { return false; }
+
+  auto ret = true;
+  is_running_ = true;
+  auto se = detail::scope_exit([&]() {
+    close(epfd);
+    is_running_ = false;
+  });
+
+  const auto interval_msec = static_cast<int>(
+      CPPHTTPLIB_KEEPALIVE_TIMEOUT_CHECK_INTERVAL_USECOND / 1000);
+  const auto has_idle_interval =
+      idle_interval_sec_ > 0 || idle_interval_usec_ > 0;
+  const auto idle_interval =
+      seconds{idle_interval_sec_} + microseconds{idle_interval_usec_};
+
+  // A closed listening socket doesn't wake up `epoll_wait`, so wait with a
+  // short timeout and check `svr_sock_` the same way `keep_alive` does.
+  detail::set_nonblocking(svr_sock_, true);
+  {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, svr_sock_, &ev) < 0) { return false; }
+  }
+
+  // Connections are owned by the event loop. While `busy` is set, a worker
+  // owns the socket and the buffer; the worker either re-arms the socket or
+  // closes it and puts the connection on `closed` for the loop to release.
+  std::unordered_map<EventConnection *, std::unique_ptr<EventConnection>>
+      connections;
+  std::mutex closed_mutex;
+  std::vector<EventConnection *> closed;
+
+  auto reap = [&]() {
+    std::vector<EventConnection *> items;
+    {
+      std::lock_guard<std::mutex> guard(closed_mutex);
+      items.swap(closed);
+    }
+    for (auto conn : items) {
+      connections.erase(conn);
+    }
+  };
+
+  auto close_connection = [&](EventConnection *conn) {
+    detail::shutdown_socket(conn->sock);
+    detail::close_socket(conn->sock);
+    connections.erase(conn);
+  };
+
+  auto serve = [this, epfd, &closed_mutex, &closed](EventConnection *conn) {
+    auto keep = true;
+    while (true) {
+      auto close_connection = conn->served + 1 >= keep_alive_max_count_;
+      auto connection_closed = false;
+      auto ok = false;
+      {
+        detail::EventStream strm(conn->sock, conn->buffer, read_timeout_sec_,
+                                 read_timeout_usec_, write_timeout_sec_,
+                                 write_timeout_usec_);
+        ok = process_request(strm, conn->remote_addr, conn->remote_port,
+                             conn->local_addr, conn->local_port,
+                             close_connection, connection_closed, nullptr);
+      }
+      conn->served++;
+
+      if (!ok || connection_closed || close_connection ||
+          svr_sock_ == INVALID_SOCKET) {
+        keep = false;
+        break;
+      }
+      // Pipelined request already buffered; no event will announce it.
+      if (!detail::has_request_head(conn->buffer)) { break; }
+    }
+
+    if (!keep) {
+      detail::shutdown_socket(conn->sock);
+      detail::close_socket(conn->sock);
+      std::lock_guard<std::mutex> guard(closed_mutex);
+      closed.push_back(conn);
+      return;
+    }
+
+    // Once `busy` is cleared the loop may shut the connection down, but
+    // only the loop closes an idle socket and it can't see an event on it
+    // before it is re-armed here, so the descriptor is still ours.
+    auto sock = conn->sock;
+    conn->idle_since = steady_clock::now();
+    conn->busy.store(false, std::memory_order_release);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, sock, &ev);
+  };
+
+  {
+    std::unique_ptr<TaskQueue> task_queue(new_task_queue());
+
+    std::vector<epoll_event> events(256);
+    auto last_sweep = steady_clock::now();
+    auto last_idle = last_sweep;
+
+    while (svr_sock_ != INVALID_SOCKET) {
+      auto n = epoll_wait(epfd, events.data(), static_cast<int>(events.size()),
+                          interval_msec);
+      if (n < 0 && errno != EINTR) {
+        if (svr_sock_ != INVALID_SOCKET) {
+          detail::close_socket(svr_sock_);
+          ret = false;
+        }
+        break;
+      }
+
+      for (auto i = 0; i < n; i++) {
+        auto conn = static_cast<EventConnection *>(events[i].data.ptr);
+
+        if (!conn) {
+          while (svr_sock_ != INVALID_SOCKET) {
+            socket_t sock = accept4(svr_sock_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (sock == INVALID_SOCKET) {
+              if (errno == EAGAIN || errno == EWOULDBLOCK) { break; }
+              if (errno == EINTR) { continue; }
+              if (errno == EMFILE) {
+                // The per-process limit of open file descriptors has been
+                // reached. Try to accept new connections after a short sleep.
+                std::this_thread::sleep_for(std::chrono::microseconds{1});
+                break;
+              }
+              if (svr_sock_ != INVALID_SOCKET) {
+                detail::close_socket(svr_sock_);
+                ret = false;
+              }
+              break;
+            }
+
+            detail::set_socket_opt_time(sock, SOL_SOCKET, SO_RCVTIMEO,
+                                        read_timeout_sec_, read_timeout_usec_);
+            detail::set_socket_opt_time(sock, SOL_SOCKET, SO_SNDTIMEO,
+                                        write_timeout_sec_,
+                                        write_timeout_usec_);
+
+            std::unique_ptr<EventConnection> item(new EventConnection());
+            item->sock = sock;
+            item->idle_since = steady_clock::now();
+            detail::get_remote_ip_and_port(sock, item->remote_addr,
+                                           item->remote_port);
+            detail::get_local_ip_and_port(sock, item->local_addr,
+                                          item->local_port);
+
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+            ev.data.ptr = item.get();
+            if (epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+              detail::close_socket(sock);
+              continue;
+            }
+            connections.emplace(item.get(), std::move(item));
+          }
+          continue;
+        }
+
+        // Read whatever has arrived without blocking the loop.
+        auto &buffer = conn->buffer;
+        auto size = buffer.size();
+        auto hangup = (events[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+        if (size < CPPHTTPLIB_RECV_BUFSIZ) {
+          buffer.resize(CPPHTTPLIB_RECV_BUFSIZ);
+          auto len = detail::read_socket(conn->sock, &buffer[size],
+                                         CPPHTTPLIB_RECV_BUFSIZ - size,
+                                         MSG_DONTWAIT);
+          if (len > 0) {
+            buffer.resize(size + static_cast<size_t>(len));
+          } else {
+            buffer.resize(size);
+            if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+              hangup = true;
+            }
+          }
+        }
+
+        if (detail::has_request_head(buffer)) {
+          conn->busy = true;
+          if (!task_queue->enqueue([conn, &serve]() { serve(conn); })) {
+            close_connection(conn);
+          }
+        } else if (hangup) {
+          close_connection(conn);
+        } else {
+          epoll_event ev{};
+          ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+          ev.data.ptr = conn;
+          epoll_ctl(epfd, EPOLL_CTL_MOD, conn->sock, &ev);
+        }
+      }
+
+      reap();
+
+      auto now = steady_clock::now();
+      if (has_idle_interval && n == 0 && now - last_idle >= idle_interval) {
+        task_queue->on_idle();
+        last_idle = now;
+      }
+
+      // Drop connections that have waited too long for their next request.
+      // Shutting one down wakes the loop, which then closes it as a hangup.
+      if (now - last_sweep >= seconds{1}) {
+        last_sweep = now;
+        const auto timeout = seconds{keep_alive_timeout_sec_};
+        for (auto &item : connections) {
+          auto conn = item.first;
+          if (!conn->busy.load(std::memory_order_acquire) &&
+              now - conn->idle_since > timeout) {
+            detail::shutdown_socket(conn->sock);
+          }
+        }
+      }
+    }
+
+    task_queue->shutdown();
+  }
+
+  reap();
+  for (auto &item : connections) {
+    detail::shutdown_socket(item.first->sock);
+    detail::close_socket(item.first->sock);
+  }
+
+  is_decommissioned = !ret;
+  return ret;
+}
+#endif
+
 inline bool Server::routing(Request &req, Response &res, Stream &strm) {
   if (pre_routing_handler_ &&
       pre_routing_handler_(req, res) == HandlerResponse::Handled) {
@@ -7368,6 +7769,8 @@ Server::process_request(Stream &strm, const std::string &remote_addr,
 
 inline bool Server::is_valid() const { return true; }
 
+inline bool Server::supports_event_driven() const { return true; }
+
 inline bool Server::process_and_close_socket(socket_t sock) {
   std::string remote_addr;
   int remote_port = 0;
@@ -9356,6 +9759,10 @@ inline void SSLServer::update_certs(X509 *cert, EVP_PKEY *private_key,
   }
 }
 
+// The handshake and SSL reads don't fit the event loop's plain socket reads,
+// so SSL connections are always served thread-per-connection.
+inline bool SSLServer::supports_event_driven() const { return false; }
+
 inline bool SSLServer::process_and_close_socket(socket_t sock) {
   auto ssl = detail::ssl_new(
       sock, ctx_, ctx_mutex_,
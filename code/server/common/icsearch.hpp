@@ -1,46 +1,623 @@
 #pragma once
 #include <elasticlient/client.h>
 #include <cpr/cpr.h>
+#include <curl/curl.h>
 #include <json/json.h>
 #include <iostream>
 #include <memory>
+#include <future>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <ctime>
+#include <cctype>
+#include <cstdint>
+#include <random>
 #include "logger.hpp"
+#include "jsoncodec.hpp"
 
 namespace hmy{
-bool Serialize(const Json::Value& val, std::string& dst)
+// 每个索引的写入代数，本进程内 ESInsert/ESRemove/ESBulkWriter 写入成功后递增，用于判断搜索缓存是否过期
+// 搜索通常通过别名或分区的逻辑名进行，写入分区(name-YYYY.MM)或版本索引(name_vN)时同时递增逻辑名的代数
+class ESGeneration
 {
-    Json::StreamWriterBuilder builder;
-    builder.settings_["emitUTF8"] = true;
+public:
+    static uint64_t get(const std::string& index)
+    {
+        return counter(index).load(std::memory_order_acquire);
+    }
+    static void bump(const std::string& index)
+    {
+        counter(index).fetch_add(1, std::memory_order_acq_rel);
+        std::string logical = logicalName(index);
+        if(logical != index)
+            counter(logical).fetch_add(1, std::memory_order_acq_rel);
+    }
+    // 去掉 ESPartition 的 "-YYYY.MM" 与 ESIndex::versionedName 的 "_vN" 后缀，二者可同时存在
+    static std::string logicalName(const std::string& index)
+    {
+        std::string name = index;
+        size_t n = name.size();
+        if(n > 8 && name[n - 8] == '-' && name[n - 3] == '.' && allDigits(name, n - 7, 4) && allDigits(name, n - 2, 2))
+            name.resize(n - 8);
+        size_t pos = name.rfind("_v");
+        if(pos != std::string::npos && pos > 0 && allDigits(name, pos + 2, name.size() - pos - 2))
+            name.resize(pos);
+        return name;
+    }
+private:
+    static bool allDigits(const std::string& str, size_t pos, size_t len)
+    {
+        if(len == 0)
+            return false;
+        for(size_t i = pos; i < pos + len; ++i)
+        {
+            if(str[i] < '0' || str[i] > '9')
+                return false;
+        }
+        return true;
+    }
+    // 计数器创建后不会释放，线程内缓存其地址，避免每次查询都竞争全局锁
+    static std::atomic<uint64_t>& counter(const std::string& index)
+    {
+        thread_local std::unordered_map<std::string, std::atomic<uint64_t>*> local;
+        auto it = local.find(index);
+        if(it != local.end())
+            return *it->second;
+        static std::mutex mutex;
+        static std::unordered_map<std::string, std::unique_ptr<std::atomic<uint64_t>>> counters;
+        std::unique_lock lock(mutex);
+        auto& counter = counters[index];
+        if(!counter)
+            counter = std::make_unique<std::atomic<uint64_t>>(0);
+        local.emplace(index, counter.get());
+        return *counter;
+    }
+};
+
+// 进行中的索引迁移(见 ESReindex)，迁移期间本进程通过别名写入的数据同时写入新索引，避免复制过程中的写入丢失
+// 复制使用 create 操作，不会覆盖双写进新索引的较新数据；复制期间的删除被记录下来，复制结束后在新索引上重放，
+// 避免已删除的文档被复制旧数据重新写回；双写时新索引写入失败的文档同样被记录下来，切换别名前从旧索引重新复制
+// 迁移状态只在本进程内：其他进程不会双写，迁移应在该索引唯一的写入进程中进行，其他写入进程须在迁移期间暂停写入，
+// ESReindex 在切换别名前比较两边的文档数，发现缺失时补充复制，但补充复制之后、切换之前其他进程的写入仍会丢失
+class ESMigration
+{
+public:
+    struct DocRef
+    {
+        std::string id;
+        std::string routing;
+    };
 
-    std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
-    std::stringstream ss;
-    int ret = writer->write(val, &ss);
-    if(ret != 0)
+    // 一次写入从读取 target 到写入请求完成的区间，写入方在读取 target 之前创建，写入完成后析构
+    // begin 登记迁移后等待此前开始的写入全部完成：这些写入可能没有读到新索引，只写了旧索引，须在复制开始前完成才能被复制读到
+    class Writer
     {
-        std::cout << "Json 序列化失败!\n";
-        return false;
+    public:
+        Writer()
+        {
+            // 计数后确认代数未变，保证计入的槽位是 begin 切换代数之前的那个，或者已能读到新登记的迁移
+            while(true)
+            {
+                uint64_t epoch = ESMigration::epoch().load();
+                _slot = &writers()[epoch & 1];
+                _slot->fetch_add(1);
+                if(ESMigration::epoch().load() == epoch)
+                    break;
+                _slot->fetch_sub(1);
+            }
+        }
+        Writer(Writer&& other) noexcept
+        :_slot(other._slot)
+        {
+            other._slot = nullptr;
+        }
+        Writer& operator=(Writer&& other) noexcept
+        {
+            std::swap(_slot, other._slot);
+            return *this;
+        }
+        ~Writer()
+        {
+            if(_slot)
+                _slot->fetch_sub(1, std::memory_order_release);
+        }
+    private:
+        std::atomic<int64_t>* _slot;
+    };
+
+    // 别名 name 正在迁移时返回新索引名，否则返回空
+    static std::string target(const std::string& name)
+    {
+        if(active().load() == 0)
+            return std::string();
+        std::unique_lock lock(mutex());
+        auto it = migrations().find(name);
+        return it == migrations().end() ? std::string() : it->second.target;
     }
-    dst = ss.str();
-    return true;
-}
 
-bool UnSerialize(const std::string& src, Json::Value& val)
+    // 登记迁移，并等待登记之前开始的写入完成(ESBulkWriter 中的操作要等到发送完成)
+    static void begin(const std::string& name, const std::string& target)
+    {
+        {
+            std::unique_lock lock(mutex());
+            if(migrations().emplace(name, Migration{target, {}, {}}).second)
+                active().fetch_add(1);
+        }
+        static std::mutex drain_mutex;
+        std::unique_lock lock(drain_mutex);
+        uint64_t old = epoch().fetch_add(1);
+        while(writers()[old & 1].load(std::memory_order_acquire) != 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // 结束迁移，返回期间记录的删除；切换别名之后通过别名的写入已直接进入新索引，剩余的待修复记录不再需要
+    static std::vector<DocRef> end(const std::string& name)
+    {
+        std::unique_lock lock(mutex());
+        auto it = migrations().find(name);
+        if(it == migrations().end())
+            return std::vector<DocRef>();
+        std::vector<DocRef> deletes = std::move(it->second.deletes);
+        migrations().erase(it);
+        active().fetch_sub(1, std::memory_order_release);
+        return deletes;
+    }
+
+    // 取出目前记录的删除，迁移继续进行
+    static std::vector<DocRef> takeDeletes(const std::string& name)
+    {
+        std::unique_lock lock(mutex());
+        auto it = migrations().find(name);
+        if(it == migrations().end())
+            return std::vector<DocRef>();
+        return std::move(it->second.deletes);
+    }
+
+    static void recordDelete(const std::string& name, const std::string& id, const std::string& routing)
+    {
+        std::unique_lock lock(mutex());
+        auto it = migrations().find(name);
+        if(it != migrations().end())
+            it->second.deletes.push_back(DocRef{id, routing});
+    }
+
+    // 取出目前记录的待修复文档，迁移继续进行
+    static std::vector<DocRef> takeRepairs(const std::string& name)
+    {
+        std::unique_lock lock(mutex());
+        auto it = migrations().find(name);
+        if(it == migrations().end())
+            return std::vector<DocRef>();
+        return std::move(it->second.repairs);
+    }
+
+    // 旧索引写入成功而新索引写入失败：写入仍视为成功(切换前以旧索引为准)，由 ESReindex 在切换前按旧索引修复新索引
+    static void recordRepair(const std::string& name, const std::string& id, const std::string& routing)
+    {
+        std::unique_lock lock(mutex());
+        auto it = migrations().find(name);
+        if(it != migrations().end())
+            it->second.repairs.push_back(DocRef{id, routing});
+    }
+
+    // 双写时两边必须使用相同的 ID，调用方未指定 ID 时在本地生成
+    static std::string newId()
+    {
+        thread_local std::mt19937_64 engine(std::random_device{}());
+        char buf[33];
+        snprintf(buf, sizeof(buf), "%016lx%016lx", (unsigned long)engine(), (unsigned long)engine());
+        return buf;
+    }
+private:
+    struct Migration
+    {
+        std::string target;
+        std::vector<DocRef> deletes;
+        std::vector<DocRef> repairs;
+    };
+
+    // 没有迁移时写入路径只读一次原子变量
+    static std::atomic<int>& active()
+    {
+        static std::atomic<int> count(0);
+        return count;
+    }
+    // begin 每次递增代数，写入按开始时代数的奇偶计入 writers 的两个槽位之一
+    static std::atomic<uint64_t>& epoch()
+    {
+        static std::atomic<uint64_t> epoch(0);
+        return epoch;
+    }
+    static std::atomic<int64_t>* writers()
+    {
+        static std::atomic<int64_t> writers[2] = {{0}, {0}};
+        return writers;
+    }
+    static std::mutex& mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+    static std::unordered_map<std::string, Migration>& migrations()
+    {
+        static std::unordered_map<std::string, Migration> migrations;
+        return migrations;
+    }
+};
+
+// 写入回调：ESInsert/ESRemove 写入成功后、ESBulkWriter 操作进入缓冲区后，按索引名通知本进程中登记的回调，
+// 用于让进程内的派生数据(如 ngram_index.hpp 的 NgramIndex)与 ES 由同一次写入驱动：
+//     ESWriteHooks::add("user", [idx](const std::string& id, const Json::Value& doc){
+//         idx->upsert(id, {doc["nickname"].asString(), doc["user_id"].asString(), doc["phone"].asString()});
+//     }, [idx](const std::string& id){ idx->remove(id); });
+// ID 由 ES 生成的新增操作不会通知；回调在写入线程中同步执行，应尽量轻量
+class ESWriteHooks
 {
-    Json::CharReaderBuilder builder;
-    
-    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-    std::stringstream ss;
+public:
+    using IndexCallback = std::function<void(const std::string& id, const Json::Value& doc)>;
+    using RemoveCallback = std::function<void(const std::string& id)>;
 
-    std::string err;
-    bool ret = reader->parse(src.c_str(), src.c_str() + src.size(), &val, &err);
-    if(ret == false)
+    static void add(const std::string& name, const IndexCallback& on_index, const RemoveCallback& on_remove)
     {
-        std::cout << "Json 反序列化失败: " << err << std::endl;
-        return false;
+        std::unique_lock lock(mutex());
+        hooks()[name].push_back(Hook{on_index, on_remove});
+        active().store(true, std::memory_order_release);
+    }
+
+    static void onIndex(const std::string& name, const std::string& id, const Json::Value& doc)
+    {
+        if(id.empty())
+            return;
+        for(const auto& hook : find(name))
+        {
+            if(hook.on_index)
+                hook.on_index(id, doc);
+        }
+    }
+
+    static void onRemove(const std::string& name, const std::string& id)
+    {
+        for(const auto& hook : find(name))
+        {
+            if(hook.on_remove)
+                hook.on_remove(id);
+        }
+    }
+private:
+    struct Hook
+    {
+        IndexCallback on_index;
+        RemoveCallback on_remove;
+    };
+
+    // 回调在锁外执行，可以在回调中继续写入 ES
+    static std::vector<Hook> find(const std::string& name)
+    {
+        if(!active().load(std::memory_order_acquire))
+            return std::vector<Hook>();
+        std::unique_lock lock(mutex());
+        auto it = hooks().find(name);
+        return it == hooks().end() ? std::vector<Hook>() : it->second;
+    }
+    static std::atomic<bool>& active()
+    {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+    static std::mutex& mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+    static std::unordered_map<std::string, std::vector<Hook>>& hooks()
+    {
+        static std::unordered_map<std::string, std::vector<Hook>> hooks;
+        return hooks;
+    }
+};
+
+// 搜索结果缓存：以索引名和序列化后的请求体为键，按键的哈希分片，每个分片独立加锁、按 LRU 淘汰
+// 条目在超过 ttl 秒或所属索引的写入代数变化后失效；其他进程的写入只能等 ttl 到期
+class ESSearchCache
+{
+public:
+    using ptr = std::shared_ptr<ESSearchCache>;
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t expired; // 因 ttl 到期或写入代数变化而失效的次数(计入 misses)
+        uint64_t evictions;
+        size_t size;
+    };
+
+    ESSearchCache(size_t capacity = 10000, double ttl = 5, size_t shards = 16)
+    : _ttl(ttl), _shards(std::max<size_t>(shards, 1)), _hits(0), _misses(0), _expired(0), _evictions(0)
+    {
+        _shard_capacity = std::max<size_t>(capacity / _shards.size(), 1);
+    }
+
+    bool get(const std::string& index, const std::string& body, Json::Value& result)
+    {
+        std::string key = index + '\n' + body;
+        Shard& shard = shardOf(key);
+        std::unique_lock lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if(it == shard.entries.end())
+        {
+            _misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        Entry& entry = *it->second;
+        if(std::chrono::steady_clock::now() >= entry.expire || entry.generation != ESGeneration::get(index))
+        {
+            shard.lru.erase(it->second);
+            shard.entries.erase(it);
+            _expired.fetch_add(1, std::memory_order_relaxed);
+            _misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        result = entry.result;
+        _hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // generation 为发起搜索前读取的写入代数，搜索期间有写入时该条目会被视为过期
+    void put(const std::string& index, const std::string& body, uint64_t generation, const Json::Value& result)
+    {
+        std::string key = index + '\n' + body;
+        Shard& shard = shardOf(key);
+        std::unique_lock lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if(it != shard.entries.end())
+        {
+            shard.lru.erase(it->second);
+            shard.entries.erase(it);
+        }
+        auto expire = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(_ttl));
+        shard.lru.push_front(Entry{key, result, generation, expire});
+        shard.entries.emplace(key, shard.lru.begin());
+        while(shard.lru.size() > _shard_capacity)
+        {
+            shard.entries.erase(shard.lru.back().key);
+            shard.lru.pop_back();
+            _evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Stats stats()
+    {
+        size_t size = 0;
+        for(auto& shard : _shards)
+        {
+            std::unique_lock lock(shard.mutex);
+            size += shard.lru.size();
+        }
+        return Stats{_hits.load(), _misses.load(), _expired.load(), _evictions.load(), size};
+    }
+private:
+    struct Entry
+    {
+        std::string key;
+        Json::Value result;
+        uint64_t generation;
+        std::chrono::steady_clock::time_point expire;
+    };
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> lru; // 最近使用的在前
+        std::unordered_map<std::string, std::list<Entry>::iterator> entries;
+    };
+
+    Shard& shardOf(const std::string& key)
+    {
+        return _shards[std::hash<std::string>()(key) % _shards.size()];
     }
-    return true;
+
+private:
+    double _ttl;
+    size_t _shard_capacity;
+    std::vector<Shard> _shards;
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _misses;
+    std::atomic<uint64_t> _expired;
+    std::atomic<uint64_t> _evictions;
+};
+
+ESSearchCache::ptr g_es_search_cache;
+// 开启搜索结果缓存，之后所有 ESSearch 默认先查缓存，可用 ESSearch::nocache 跳过
+void init_es_search_cache(size_t capacity = 10000, double ttl = 5)
+{
+    g_es_search_cache = std::make_shared<ESSearchCache>(capacity, ttl);
 }
 
+// 按月分区的索引
+// 数据存放在分区索引 <name>-YYYY.MM(UTC 月份)中，别名 <name> 指向全部分区，其中当月分区被标记为写入索引(is_write_index)：
+// 按 <name> 新增的文档进入当月分区，按 <name> 搜索覆盖全部分区；分区的映射由索引模板 <name> 统一设置，新分区创建后自动加入别名
+// 写入索引只能在分区之间切换，经别名的单文档写入只作用于当月分区：修改/删除往月文档需通过 ESInsert/ESRemove::partition
+// 或 ESBulkWriter 的 partition 参数指定分区(indexFor 得到的分区名，或搜索结果中的 _index)
+class ESPartition
+{
+public:
+    static std::string indexFor(const std::string& name, int64_t time)
+    {
+        std::tm tm = toTm(time);
+        char buf[32];
+        snprintf(buf, sizeof(buf), "-%04d.%02d", tm.tm_year + 1900, tm.tm_mon + 1);
+        return name + buf;
+    }
+
+    // 与 [start, end] 时间范围(秒)有交集的分区，超过 MAX_PRUNED_PARTITIONS 个时返回空，由调用方改为查询全部分区
+    static std::vector<std::string> indicesBetween(const std::string& name, int64_t start, int64_t end)
+    {
+        std::vector<std::string> indices;
+        for(int64_t month = monthStart(start); month <= end; month = nextMonth(month))
+        {
+            if(indices.size() >= MAX_PRUNED_PARTITIONS)
+                return std::vector<std::string>();
+            indices.push_back(indexFor(name, month));
+        }
+        return indices;
+    }
+
+    static int64_t monthStart(int64_t time)
+    {
+        std::tm tm = toTm(time);
+        tm.tm_mday = 1;
+        tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+        return timegm(&tm);
+    }
+
+    static int64_t nextMonth(int64_t time)
+    {
+        std::tm tm = toTm(time);
+        tm.tm_mday = 1;
+        tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+        tm.tm_mon += 1; // timegm 会把 12 月进位到下一年
+        return timegm(&tm);
+    }
+
+    // 创建分区索引，已存在时视为成功；映射来自索引模板
+    static bool createPartition(const std::shared_ptr<elasticlient::Client>& client, const std::string& index)
+    {
+        try
+        {
+            auto rsp = client->performRequest(elasticlient::Client::HTTPMethod::PUT, index, "{}");
+            if((rsp.status_code < 200 || rsp.status_code >= 300) && rsp.text.find("resource_already_exists_exception") == std::string::npos)
+            {
+                LOG_ERROR("创建ES分区索引 {} 失败, 响应状态码异常: {} {}", index, rsp.status_code, rsp.text);
+                return false;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR("创建ES分区索引 {} 失败：{}", index, e.what());
+            return false;
+        }
+        return true;
+    }
+
+    // 确保 time 所在月份的分区存在，并在一次别名操作中把写入索引原子地切换到该分区
+    // 重复调用是幂等的，由 ESRollover 定期调用
+    static bool rollover(const std::shared_ptr<elasticlient::Client>& client, const std::string& name, int64_t time)
+    {
+        std::string index = indexFor(name, time);
+        if(createPartition(client, index) == false)
+            return false;
+        // 先把所有分区标记为非写入索引，再标记新分区，同一请求中的操作按顺序生效
+        Json::Value all, current, actions(Json::arrayValue);
+        all["add"]["index"] = name + "-*";
+        all["add"]["alias"] = name;
+        all["add"]["is_write_index"] = false;
+        current["add"]["index"] = index;
+        current["add"]["alias"] = name;
+        current["add"]["is_write_index"] = true;
+        actions.append(all);
+        actions.append(current);
+        Json::Value root;
+        root["actions"] = actions;
+        std::string body;
+        if(Serialize(root, body) == false)
+        {
+            LOG_ERROR("别名操作序列化失败!");
+            return false;
+        }
+        try
+        {
+            auto rsp = client->performRequest(elasticlient::Client::HTTPMethod::POST, "_aliases", body);
+            if(rsp.status_code < 200 || rsp.status_code >= 300)
+            {
+                LOG_ERROR("切换ES写入分区 {} 失败, 响应状态码异常: {} {}", index, rsp.status_code, rsp.text);
+                return false;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR("切换ES写入分区 {} 失败：{}", index, e.what());
+            return false;
+        }
+        ESGeneration::bump(name);
+        LOG_INFO("ES索引 {} 的写入分区切换为 {}", name, index);
+        return true;
+    }
+private:
+    static std::tm toTm(int64_t time)
+    {
+        time_t t = (time_t)time;
+        std::tm tm;
+        gmtime_r(&t, &tm);
+        return tm;
+    }
+
+    static constexpr size_t MAX_PRUNED_PARTITIONS = 24;
+};
+
+// 分区索引的自动切换：后台线程每 check_interval 秒检查一次，月份变化后调用 ESPartition::rollover，
+// 并在月末最后一天提前创建下个月的分区，避免月初第一次写入时才创建索引
+// 切换前的一小段时间内，新月份的文档仍会写入上个月的分区，ESSearch 按时间裁剪分区时会留出余量
+class ESRollover
+{
+public:
+    using ptr = std::shared_ptr<ESRollover>;
+    ESRollover(std::shared_ptr<elasticlient::Client>& client, const std::string& name, int check_interval = 60)
+    :_name(name),_client(client),_interval(check_interval),_stop(false)
+    {
+        _thread = std::thread(&ESRollover::loop, this);
+    }
+
+    ~ESRollover()
+    {
+        {
+            std::unique_lock lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        _thread.join();
+    }
+private:
+    void loop()
+    {
+        std::string current, precreated;
+        std::unique_lock lock(_mutex);
+        while(!_stop)
+        {
+            lock.unlock();
+            int64_t now = time(nullptr);
+            std::string index = ESPartition::indexFor(_name, now);
+            if(index != current && ESPartition::rollover(_client, _name, now))
+                current = index;
+            int64_t next = ESPartition::nextMonth(now);
+            std::string next_index = ESPartition::indexFor(_name, next);
+            if(next - now < PRECREATE_AHEAD && next_index != precreated && ESPartition::createPartition(_client, next_index))
+                precreated = next_index;
+            lock.lock();
+            _cond.wait_for(lock, std::chrono::seconds(_interval), [this](){ return _stop; });
+        }
+    }
+
+private:
+    static constexpr int64_t PRECREATE_AHEAD = 24 * 3600;
+
+    std::string _name;
+    std::shared_ptr<elasticlient::Client> _client;
+    int _interval;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _stop;
+    std::thread _thread;
+};
+
 class ESIndex
 {
 public:
@@ -59,140 +636,1476 @@ public:
         _index["settings"] = analysis;
     }
 
-    ESIndex& append(const std::string& key, const std::string& type = "text", const std::string& analyzer = "ik_max_word", bool enabled = true)
+    // 输入即搜索(见 ESSearch::append_typeahead)用的子字段，可按位组合
+    enum SubField
+    {
+        PREFIX = 1, // <key>.prefix：原文的 edge-ngram，前缀匹配变为词项查找
+        PINYIN = 2, // <key>.pinyin：全拼和首字母的 edge-ngram，需要 ES 安装 analysis-pinyin 插件
+    };
+    static constexpr const char* PREFIX_FIELD = "prefix";
+    static constexpr const char* PINYIN_FIELD = "pinyin";
+    static constexpr int MAX_PREFIX_LENGTH = 20; // 前缀子字段收录的最大前缀长度(字符)
+
+    ESIndex& append(const std::string& key, const std::string& type = "text", const std::string& analyzer = "ik_max_word", bool enabled = true, int subfields = 0)
+    {
+        Json::Value fields;
+        fields["type"] = type;
+        fields["analyzer"] = analyzer;
+        if(enabled == false)
+            fields["enabled"] = enabled;
+        if(subfields & PREFIX)
+            fields["fields"][PREFIX_FIELD] = prefixField("hmy_prefix");
+        if(subfields & PINYIN)
+            fields["fields"][PINYIN_FIELD] = prefixField("hmy_pinyin_prefix");
+        
+        _properties[key] = fields;
+
+        return *this;
+    }
+
+    bool create(const std::string& index_id = "default_index_id")
+    {
+        // 1. 序列化
+        Json::Value mappings;
+        mappings["dynamic"] = true;
+        mappings["properties"] = _properties;
+        _index["mappings"] = mappings;
+        if(_partitioned)
+            return createPartitioned();
+        if(_version > 0)
+            return createVersioned();
+
+        std::string body;
+        bool ret = Serialize(_index, body);
+        if(ret == false)
+        {
+            LOG_ERROR("索引序列化失败!");
+            return false;
+        }
+
+        // 2. 发起创建索引请求
+        try
+        {
+            auto rsp = _client->index(_name, _type, index_id, body);
+            if(rsp.status_code < 200 || rsp.status_code >= 300)
+            {
+                LOG_ERROR("创建ES索引 {} 失败, 响应状态码异常: {}", _name, rsp.status_code);
+                return false;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR("创建ES索引 {} 失败：{}", _name, e.what());
+            return false;
+        }
+        ESGeneration::bump(_name);
+        return true;
+    }
+
+    // 按月分区(见 ESPartition)：create 创建索引模板和当月分区，之后由 ESRollover 切换月份
+    ESIndex& partitioned()
+    {
+        _partitioned = true;
+        return *this;
+    }
+
+    // 版本化索引：create 创建实际索引 <name>_v<version>，name 作为别名使用
+    // 别名 name 尚不存在时直接指向新索引；已指向旧版本(或 name 是旧的普通索引)时保持不变，由 ESReindex 复制数据后切换
+    ESIndex& version(int version)
+    {
+        _version = version;
+        return *this;
+    }
+
+    static std::string versionedName(const std::string& name, int version)
+    {
+        return name + "_v" + std::to_string(version);
+    }
+private:
+    // 写入时生成前缀词项，搜索时输入按空白切分后每段作为一个完整前缀查找
+    Json::Value prefixField(const std::string& analyzer)
+    {
+        Json::Value& analysis = _index["settings"]["analysis"];
+        if(!analysis["analyzer"].isMember("hmy_prefix_search"))
+        {
+            Json::Value token_chars(Json::arrayValue);
+            token_chars.append("letter");
+            token_chars.append("digit");
+            Json::Value& edge_ngram = analysis["tokenizer"]["hmy_edge_ngram"];
+            edge_ngram["type"] = "edge_ngram";
+            edge_ngram["min_gram"] = 1;
+            edge_ngram["max_gram"] = MAX_PREFIX_LENGTH;
+            edge_ngram["token_chars"] = token_chars;
+
+            Json::Value& search = analysis["analyzer"]["hmy_prefix_search"];
+            search["type"] = "custom";
+            search["tokenizer"] = "whitespace";
+            search["filter"].append("lowercase");
+        }
+        if(analyzer == "hmy_prefix" && !analysis["analyzer"].isMember(analyzer))
+        {
+            Json::Value& prefix = analysis["analyzer"][analyzer];
+            prefix["type"] = "custom";
+            prefix["tokenizer"] = "hmy_edge_ngram";
+            prefix["filter"].append("lowercase");
+        }
+        if(analyzer == "hmy_pinyin_prefix" && !analysis["analyzer"].isMember(analyzer))
+        {
+            // "小明" -> 全拼 "xiaoming" 和首字母 "xm"，再切成前缀
+            Json::Value& pinyin = analysis["tokenizer"]["hmy_pinyin"];
+            pinyin["type"] = "pinyin";
+            pinyin["keep_first_letter"] = true;
+            pinyin["keep_separate_first_letter"] = false;
+            pinyin["keep_full_pinyin"] = false;
+            pinyin["keep_joined_full_pinyin"] = true;
+            pinyin["keep_original"] = false;
+            pinyin["keep_none_chinese_in_joined_full_pinyin"] = true;
+            pinyin["limit_first_letter_length"] = MAX_PREFIX_LENGTH;
+            pinyin["lowercase"] = true;
+            pinyin["remove_duplicated_term"] = true;
+
+            Json::Value& filter = analysis["filter"]["hmy_edge_ngram"];
+            filter["type"] = "edge_ngram";
+            filter["min_gram"] = 1;
+            filter["max_gram"] = MAX_PREFIX_LENGTH;
+
+            Json::Value& prefix = analysis["analyzer"][analyzer];
+            prefix["type"] = "custom";
+            prefix["tokenizer"] = "hmy_pinyin";
+            prefix["filter"].append("hmy_edge_ngram");
+        }
+        Json::Value field;
+        field["type"] = "text";
+        field["analyzer"] = analyzer;
+        field["search_analyzer"] = "hmy_prefix_search";
+        return field;
+    }
+
+    bool createVersioned()
+    {
+        std::string index = versionedName(_name, _version);
+        std::string body;
+        if(Serialize(_index, body) == false)
+        {
+            LOG_ERROR("索引序列化失败!");
+            return false;
+        }
+        try
+        {
+            auto rsp = _client->performRequest(elasticlient::Client::HTTPMethod::PUT, index, body);
+            if((rsp.status_code < 200 || rsp.status_code >= 300) && rsp.text.find("resource_already_exists_exception") == std::string::npos)
+            {
+                LOG_ERROR("创建ES索引 {} 失败, 响应状态码异常: {} {}", index, rsp.status_code, rsp.text);
+                return false;
+            }
+            // name 已是别名或普通索引时不改动，迁移由 ESReindex 完成
+            rsp = _client->performRequest(elasticlient::Client::HTTPMethod::HEAD, _name, "");
+            if(rsp.status_code != 404)
+            {
+                if(rsp.status_code < 200 || rsp.status_code >= 300)
+                {
+                    LOG_ERROR("查询ES索引 {} 失败, 响应状态码异常: {}", _name, rsp.status_code);
+                    return false;
+                }
+                LOG_INFO("ES索引 {} 已创建，{} 已存在，需要通过 ESReindex 迁移", index, _name);
+                return true;
+            }
+            Json::Value add, root;
+            add["add"]["index"] = index;
+            add["add"]["alias"] = _name;
+            root["actions"].append(add);
+            Serialize(root, body);
+            rsp = _client->performRequest(elasticlient::Client::HTTPMethod::POST, "_aliases", body);
+            if(rsp.status_code < 200 || rsp.status_code >= 300)
+            {
+                LOG_ERROR("创建ES别名 {} 失败, 响应状态码异常: {} {}", _name, rsp.status_code, rsp.text);
+                return false;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR("创建ES索引 {} 失败：{}", index, e.what());
+            return false;
+        }
+        ESGeneration::bump(_name);
+        return true;
+    }
+
+    bool createPartitioned()
+    {
+        _index["index_patterns"].append(_name + "-*");
+        _index["aliases"][_name] = Json::Value(Json::objectValue);
+        std::string body;
+        if(Serialize(_index, body) == false)
+        {
+            LOG_ERROR("索引模板序列化失败!");
+            return false;
+        }
+        try
+        {
+            auto rsp = _client->performRequest(elasticlient::Client::HTTPMethod::PUT, "_template/" + _name, body);
+            if(rsp.status_code < 200 || rsp.status_code >= 300)
+            {
+                LOG_ERROR("创建ES索引模板 {} 失败, 响应状态码异常: {} {}", _name, rsp.status_code, rsp.text);
+                return false;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR("创建ES索引模板 {} 失败：{}", _name, e.what());
+            return false;
+        }
+        return ESPartition::rollover(_client, _name, time(nullptr));
+    }
+
+private:
+    std::string _name;
+    std::string _type;
+    bool _partitioned = false;
+    int _version = 0;
+    Json::Value _properties;
+    Json::Value _index;
+    std::shared_ptr<elasticlient::Client> _client;
+};
+
+class ESInsert
+{
+public:
+    ESInsert(std::shared_ptr<elasticlient::Client>& client, const std::string& name, const std::string& type)
+    :_name(name),_type(type),_client(client)
+    {}
+
+    ESInsert& append(const std::string& key, const std::string& val)
+    {
+        _item[key] = val;
+        return *this;
+    }
+
+    // 路由值，相同路由值的文档写入同一个分片，如消息按 chat_session_id 路由；查询和删除时须使用相同的路由值
+    ESInsert& routing(const std::string& routing)
+    {
+        _routing = routing;
+        return *this;
+    }
+
+    // 按月分区的索引(见 ESPartition)：写入 time(秒)所在月份的分区，或搜索结果中 _index 给出的分区
+    // 通过别名只能写入当月分区，修改往月的已有文档时必须指定，否则会在当月分区中产生 ID 相同的重复文档
+    ESInsert& partition(int64_t time)
+    {
+        _index = ESPartition::indexFor(_name, time);
+        return *this;
+    }
+    ESInsert& partition(const std::string& index)
+    {
+        _index = index;
+        return *this;
+    }
+
+    bool insert(const std::string& id = "")
+    {
+        std::string body;
+        bool ret = Serialize(_item, body);
+        if(ret == false)
+        {
+            LOG_ERROR("索引序列化失败!");
+            return false;
+        }
+
+        // 2. 发起新增数据请求
+        ESMigration::Writer writer;
+        std::string target = ESMigration::target(_name);
+        std::string doc_id = target.empty() || !id.empty() ? id : ESMigration::newId();
+        try
+        {
+            auto rsp = _client->index(_index.empty() ? _name : _index, _type, doc_id, body, _routing);
+            if(rsp.status_code < 200 || rsp.status_code >= 300)
+            {
+                LOG_ERROR_RL("新增数据 {} 失败, 响应状态码异常: {}", body, rsp.status_code);
+                return false;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR_RL("新增数据 {} 失败：{}", body, e.what());
+            return false;
+        }
+        // 迁移中，同时写入新索引；旧索引已写入成功，新索引失败时记录下来由迁移修复
+        if(!target.empty())
+            mirror(target, doc_id, body);
+        ESGeneration::bump(_name);
+        ESWriteHooks::onIndex(_name, doc_id, _item);
+        return true;
+    }
+
+private:
+    void mirror(const std::string& target, const std::string& doc_id, const std::string& body)
+    {
+        try
+        {
+            auto rsp = _client->index(target, _type, doc_id, body, _routing);
+            if(rsp.status_code >= 200 && rsp.status_code < 300)
+                return;
+            LOG_WARN_RL("新增数据 {} 到迁移目标 {} 失败, 响应状态码异常: {}", doc_id, target, rsp.status_code);
+        }
+        catch(const std::exception& e)
+        {
+            LOG_WARN_RL("新增数据 {} 到迁移目标 {} 失败：{}", doc_id, target, e.what());
+        }
+        ESMigration::recordRepair(_name, doc_id, _routing);
+    }
+
+private:
+    std::string _name;
+    std::string _index; // 指定的分区，为空时按 _name 写入
+    std::string _type;
+    std::string _routing;
+    Json::Value _item;
+    std::shared_ptr<elasticlient::Client> _client;
+};
+
+class ESRemove
+{
+public:
+    ESRemove(std::shared_ptr<elasticlient::Client>& client, const std::string& name, const std::string& type)
+    :_name(name),_type(type),_client(client)
+    {}
+
+    // 按月分区的索引(见 ESPartition)：从 time(秒)所在月份的分区，或搜索结果中 _index 给出的分区删除
+    // 通过别名只能删除当月分区中的文档，往月的文档会返回 404
+    ESRemove& partition(int64_t time)
+    {
+        _index = ESPartition::indexFor(_name, time);
+        return *this;
+    }
+    ESRemove& partition(const std::string& index)
+    {
+        _index = index;
+        return *this;
+    }
+
+    // 写入时指定了路由值的文档，删除时须传入相同的路由值
+    bool remove(const std::string& id, const std::string& routing = "")
+    {
+        ESMigration::Writer writer;
+        std::string target = ESMigration::target(_name);
+        try
+        {
+            auto rsp = _client->remove(_index.empty() ? _name : _index, _type, id, routing);
+            if(rsp.status_code < 200 || rsp.status_code >= 300)
+            {
+                LOG_ERROR_RL("删除数据 {} 失败, 响应状态码异常: {}", id, rsp.status_code);
+                return false;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR_RL("删除数据 {} 失败：{}", id, e.what());
+            return false;
+        }
+        // 迁移中，新索引里可能还没有该文档(404)，记录下来在复制结束后重放；新索引删除失败时同样由重放补上
+        if(!target.empty())
+        {
+            ESMigration::recordDelete(_name, id, routing);
+            try
+            {
+                auto rsp = _client->remove(target, _type, id, routing);
+                if((rsp.status_code < 200 || rsp.status_code >= 300) && rsp.status_code != 404)
+                    LOG_WARN_RL("从迁移目标 {} 删除数据 {} 失败, 响应状态码异常: {}", target, id, rsp.status_code);
+            }
+            catch(const std::exception& e)
+            {
+                LOG_WARN_RL("从迁移目标 {} 删除数据 {} 失败：{}", target, id, e.what());
+            }
+        }
+        ESGeneration::bump(_name);
+        ESWriteHooks::onRemove(_name, id);
+        return true;
+    }
+private:
+    std::string _name;
+    std::string _index; // 指定的分区，为空时按 _name 删除
+    std::string _type; 
+    std::shared_ptr<elasticlient::Client> _client;
+};
+
+
+// 批量写入参数，达到 max_actions 条、max_bytes 字节或距上次发送超过 flush_interval 秒时发送一次 _bulk 请求
+struct ESBulkOptions
+{
+    size_t max_actions = 1000; // 单次 _bulk 请求最多包含的操作数
+    size_t max_bytes = 5 * 1024 * 1024; // 单次 _bulk 请求体的大小上限
+    double flush_interval = 1; // 未达到阈值的操作最多等待的时间(秒)
+    size_t max_buffer_bytes = 64 * 1024 * 1024; // 缓冲区上限，写满后新的操作阻塞等待或被拒绝
+    bool block_when_full = true; // 缓冲区满时 true--阻塞等待，false--立即返回 false
+    int max_retries = 3; // 整个请求失败(网络错误或 5xx)时的重试次数
+};
+
+// 单个操作写入失败的信息
+struct ESBulkError
+{
+    std::string action; // index / delete
+    std::string id;
+    int status; // ES 返回的状态码，整个请求失败时为 0
+    std::string reason;
+};
+
+// 批量写入：index/remove 只把操作以 NDJSON 追加到缓冲区，由后台线程通过 _bulk 接口批量发送
+// 单个操作失败通过错误回调逐条报告，默认输出错误日志
+class ESBulkWriter
+{
+public:
+    using ptr = std::shared_ptr<ESBulkWriter>;
+    using ErrorCallback = std::function<void(const ESBulkError&)>;
+    ESBulkWriter(std::shared_ptr<elasticlient::Client>& client, const std::string& name, const std::string& type,
+        const ESBulkOptions& options = ESBulkOptions())
+    :_name(name),_type(type),_client(client),_options(options),_stop(false),_sending(false)
+    {
+        _error_cb = [](const ESBulkError& error){
+            LOG_ERROR_RL("批量写入操作 {} {} 失败, 状态码: {}, 原因: {}", error.action, error.id, error.status, error.reason);
+        };
+        _last_flush = std::chrono::steady_clock::now();
+        _thread = std::thread(&ESBulkWriter::flushLoop, this);
+    }
+
+    // 析构时发送缓冲区中剩余的全部操作
+    ~ESBulkWriter()
+    {
+        {
+            std::unique_lock lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        _thread.join();
+    }
+
+    void setErrorCallback(const ErrorCallback& cb)
+    {
+        std::unique_lock lock(_mutex);
+        _error_cb = cb;
+    }
+
+    // id 为空时由 ES 生成
+    // 别名正在迁移(见 ESMigration)时同一操作也写入新索引
+    // 写入新索引的操作失败时不报告给错误回调，index 操作记录下来由迁移修复，delete 操作由迁移重放
+    // 按月分区的索引(见 ESPartition)修改/删除往月的已有文档时，partition 须为文档所在的分区(ESPartition::indexFor 或搜索结果中的 _index)
+    bool index(const Json::Value& doc, const std::string& id = "", const std::string& routing = "", const std::string& partition = "")
+    {
+        ESMigration::Writer writer;
+        std::string target = ESMigration::target(_name);
+        std::string doc_id = target.empty() || !id.empty() ? id : ESMigration::newId();
+        std::string body;
+        if(Serialize(doc, body) == false)
+        {
+            LOG_ERROR("批量新增数据 {} 序列化失败!", id);
+            return false;
+        }
+        body.push_back('\n');
+        if(enqueueAction("index", partition.empty() ? _name : partition, doc_id, routing, body, std::move(writer)) == false)
+            return false;
+        ESWriteHooks::onIndex(_name, doc_id, doc);
+        if(!target.empty() && enqueueAction("index", target, doc_id, routing, body, ESMigration::Writer(), true) == false)
+            ESMigration::recordRepair(_name, doc_id, routing);
+        return true;
+    }
+
+    bool remove(const std::string& id, const std::string& routing = "", const std::string& partition = "")
+    {
+        ESMigration::Writer writer;
+        std::string target = ESMigration::target(_name);
+        if(enqueueAction("delete", partition.empty() ? _name : partition, id, routing, "", std::move(writer)) == false)
+            return false;
+        ESWriteHooks::onRemove(_name, id);
+        if(target.empty())
+            return true;
+        ESMigration::recordDelete(_name, id, routing);
+        enqueueAction("delete", target, id, routing, "", ESMigration::Writer(), true);
+        return true;
+    }
+
+    // 立即发送缓冲区中的操作，并等待发送完成
+    void flush()
+    {
+        std::unique_lock lock(_mutex);
+        _flush_requested = true;
+        _cond.notify_all();
+        _done_cond.wait(lock, [this](){ return (_items.empty() && !_sending) || _stop; });
+    }
+
+    // 缓冲区中等待发送的操作数
+    size_t pending()
+    {
+        std::unique_lock lock(_mutex);
+        return _items.size();
+    }
+private:
+    struct Item
+    {
+        std::string action;
+        std::string id;
+        std::string routing;
+        bool mirror; // 迁移中写入新索引的操作
+        ESMigration::Writer writer; // 操作发送完成前迁移不会开始复制
+    };
+
+    // body 为 index 操作的文档(含结尾换行)，delete 操作为空
+    bool enqueueAction(const std::string& action, const std::string& index, const std::string& id, const std::string& routing, const std::string& body,
+        ESMigration::Writer&& writer, bool mirror = false)
+    {
+        Json::Value meta;
+        meta["_index"] = index;
+        meta["_type"] = _type;
+        if(!id.empty())
+            meta["_id"] = id;
+        if(!routing.empty())
+            meta["routing"] = routing;
+        Json::Value root;
+        root[action] = meta;
+        std::string line;
+        if(Serialize(root, line) == false)
+        {
+            LOG_ERROR("批量操作 {} {} 序列化失败!", action, id);
+            return false;
+        }
+        line.push_back('\n');
+        line.append(body);
+        return enqueue(Item{action, id, routing, mirror, std::move(writer)}, line);
+    }
+
+    bool enqueue(Item&& item, const std::string& line)
+    {
+        std::unique_lock lock(_mutex);
+        if(_buffer.size() + line.size() > _options.max_buffer_bytes && !_buffer.empty())
+        {
+            if(!_options.block_when_full)
+            {
+                LOG_WARN_RL("{} 批量写入缓冲区已满，拒绝新的操作", _name);
+                return false;
+            }
+            _done_cond.wait(lock, [&](){ return _stop || _buffer.size() + line.size() <= _options.max_buffer_bytes || _buffer.empty(); });
+        }
+        if(_stop)
+            return false;
+        _buffer.append(line);
+        _items.push_back(std::move(item));
+        if(_items.size() >= _options.max_actions || _buffer.size() >= _options.max_bytes)
+            _cond.notify_all();
+        return true;
+    }
+
+    bool ready() const
+    {
+        return _items.size() >= _options.max_actions || _buffer.size() >= _options.max_bytes || _flush_requested
+            || (!_items.empty() && std::chrono::steady_clock::now() - _last_flush >= std::chrono::duration<double>(_options.flush_interval));
+    }
+
+    void flushLoop()
+    {
+        std::unique_lock lock(_mutex);
+        while(true)
+        {
+            _cond.wait_for(lock, std::chrono::duration<double>(_options.flush_interval), [this](){ return _stop || ready(); });
+            if(_items.empty())
+            {
+                _flush_requested = false;
+                _last_flush = std::chrono::steady_clock::now();
+                _done_cond.notify_all();
+                if(_stop)
+                    return;
+                continue;
+            }
+            if(!_stop && !ready())
+                continue;
+            // 每次最多取出 max_actions 条、约 max_bytes 字节的操作
+            size_t count = 0, bytes = 0;
+            while(count < _items.size() && count < _options.max_actions && bytes < _options.max_bytes)
+            {
+                size_t end = _buffer.find('\n', bytes);
+                if(_items[count].action == "index")
+                    end = _buffer.find('\n', end + 1);
+                bytes = end + 1;
+                ++count;
+            }
+            std::string body = _buffer.substr(0, bytes);
+            std::vector<Item> items(std::make_move_iterator(_items.begin()), std::make_move_iterator(_items.begin() + count));
+            _buffer.erase(0, bytes);
+            _items.erase(_items.begin(), _items.begin() + count);
+            _sending = true;
+            _last_flush = std::chrono::steady_clock::now();
+            ErrorCallback error_cb = _error_cb;
+            lock.unlock();
+            _done_cond.notify_all();
+            send(body, items, error_cb);
+            lock.lock();
+            _sending = false;
+            _done_cond.notify_all();
+        }
+    }
+
+    void send(const std::string& body, const std::vector<Item>& items, const ErrorCallback& error_cb)
+    {
+        // 即使请求失败也可能有部分操作已生效，发送后总是使缓存失效
+        struct Invalidate
+        {
+            const std::string& name;
+            ~Invalidate() { ESGeneration::bump(name); }
+        } invalidate{_name};
+        cpr::Response rsp;
+        std::string reason;
+        for(int attempt = 0; attempt <= _options.max_retries; ++attempt)
+        {
+            if(attempt > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(100 << std::min(attempt, 6)));
+            try
+            {
+                rsp = _client->performRequest(elasticlient::Client::HTTPMethod::POST, "_bulk", body);
+                if(rsp.status_code >= 200 && rsp.status_code < 300)
+                {
+                    reportItems(rsp.text, items, error_cb);
+                    return;
+                }
+                reason = "响应状态码异常: " + std::to_string(rsp.status_code);
+                // 4xx 是请求本身的问题，重试也不会成功
+                if(rsp.status_code >= 400 && rsp.status_code < 500)
+                    break;
+            }
+            catch(const std::exception& e)
+            {
+                reason = e.what();
+            }
+        }
+        LOG_ERROR_RL("{} 批量写入 {} 条操作失败: {}", _name, items.size(), reason);
+        for(const auto& item : items)
+            reportError(item, ESBulkError{item.action, item.id, 0, reason}, error_cb);
+    }
+
+    void reportError(const Item& item, const ESBulkError& error, const ErrorCallback& error_cb)
+    {
+        if(!item.mirror)
+        {
+            error_cb(error);
+            return;
+        }
+        LOG_WARN_RL("{} 批量写入迁移目标的操作 {} {} 失败, 状态码: {}, 原因: {}", _name, error.action, error.id, error.status, error.reason);
+        if(item.action == "index")
+            ESMigration::recordRepair(_name, item.id, item.routing);
+    }
+
+    // 响应中 errors 为 true 时逐条检查 items，结果与请求中的操作按顺序一一对应
+    void reportItems(const std::string& text, const std::vector<Item>& items, const ErrorCallback& error_cb)
+    {
+        Json::Value result;
+        if(UnSerialize(text, result) == false)
+        {
+            LOG_ERROR_RL("{} 批量写入响应反序列化失败", _name);
+            return;
+        }
+        if(result["errors"].asBool() == false)
+            return;
+        const Json::Value& results = result["items"];
+        for(Json::ArrayIndex i = 0; i < results.size() && i < items.size(); ++i)
+        {
+            const Json::Value& item = results[i][items[i].action];
+            int status = item["status"].asInt();
+            if(status >= 200 && status < 300)
+                continue;
+            // 删除不存在的文档不算失败
+            if(status == 404 && items[i].action == "delete")
+                continue;
+            const Json::Value& error = item["error"];
+            std::string reason = error.isObject() ? error["type"].asString() + ": " + error["reason"].asString() : error.asString();
+            reportError(items[i], ESBulkError{items[i].action, items[i].id, status, reason}, error_cb);
+        }
+    }
+
+private:
+    std::string _name;
+    std::string _type;
+    std::shared_ptr<elasticlient::Client> _client;
+    ESBulkOptions _options;
+
+    std::mutex _mutex;
+    std::condition_variable _cond; // 通知后台线程有操作达到发送阈值
+    std::condition_variable _done_cond; // 通知等待缓冲区空间或 flush 完成的线程
+    std::string _buffer; // 等待发送的 NDJSON
+    std::vector<Item> _items; // 与 _buffer 中的操作按顺序对应
+    bool _stop;
+    bool _sending;
+    bool _flush_requested = false;
+    std::chrono::steady_clock::time_point _last_flush;
+    ErrorCallback _error_cb;
+    std::thread _thread;
+};
+
+// 迁移参数
+struct ESReindexOptions
+{
+    size_t batch_size = 500; // 每批通过 scroll 取出、再用一次 _bulk 写入的文档数
+    double max_docs_per_second = 2000; // 复制速率上限，避免迁移占用集群资源影响在线搜索；<= 0 表示不限速
+    std::string scroll = "5m"; // 两批之间 scroll 上下文的保留时间
+    int max_retries = 3; // 单批 _bulk 请求失败(网络错误或 5xx)时的重试次数
+    int verify_rounds = 3; // 切换别名前新索引文档数少于旧索引时补充复制的最多轮数，仍然不足时放弃切换
+};
+
+// 零停机迁移：把别名 name 当前指向的索引(或名为 name 的旧普通索引)复制到新版本索引，完成后原子地把别名切换过去
+// 用法：
+//     ESIndex(client, "user", "_doc").version(2).append(...).create();
+//     ESReindex reindex(client, "user", "_doc");
+//     reindex.start(ESIndex::versionedName("user", 2));
+//     ...
+//     reindex.wait();
+// 复制期间搜索仍走旧索引；本进程的写入同时写入新索引(见 ESMigration)；切换后旧版本索引保留，确认无误后手动删除，
+// name 原本是普通索引时没有别名可切换，该索引在切换别名的同一请求中被删除
+// 只有发起迁移的进程会双写，其他写入该索引的进程须在迁移期间暂停写入(见 ESMigration)
+// 不支持按月分区的索引
+class ESReindex
+{
+public:
+    using ptr = std::shared_ptr<ESReindex>;
+    ESReindex(std::shared_ptr<elasticlient::Client>& client, const std::string& name, const std::string& type,
+        const ESReindexOptions& options = ESReindexOptions())
+    :_name(name),_type(type),_client(client),_options(options),_stop(false),_result(false),_copied(0)
+    {}
+
+    // 析构时中止未完成的迁移，别名保持不变
+    ~ESReindex()
+    {
+        {
+            std::unique_lock lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        if(_thread.joinable())
+            _thread.join();
+    }
+
+    // 在后台线程中开始迁移，已经开始过时返回 false
+    bool start(const std::string& target)
+    {
+        if(_thread.joinable())
+            return false;
+        _thread = std::thread([this, target](){ _result = run(target); });
+        return true;
+    }
+
+    // 等待迁移结束，返回别名是否已切换到新索引
+    bool wait()
+    {
+        if(_thread.joinable())
+            _thread.join();
+        return _result;
+    }
+
+    // 已复制的文档数
+    size_t copied() const
+    {
+        return _copied.load(std::memory_order_relaxed);
+    }
+private:
+    bool run(const std::string& target)
+    {
+        std::string source;
+        bool is_alias;
+        if(resolveSource(source, is_alias) == false)
+            return false;
+        if(source == target)
+        {
+            LOG_ERROR("ES索引 {} 已指向 {}，无需迁移", _name, target);
+            return false;
+        }
+        LOG_INFO("开始迁移ES索引 {}: {} -> {}", _name, source, target);
+        // begin 返回时此前开始、没有双写的写入都已完成，刷新后才能被 scroll 读到
+        ESMigration::begin(_name, target);
+        bool ret = refresh(source) && copy(source, target) && settle(source, target) && swap(source, is_alias, target);
+        // 复制结束后的删除已直接作用于新索引，这里只是保险
+        std::vector<ESMigration::DocRef> deletes = ESMigration::end(_name);
+        if(ret)
+        {
+            replayDeletes(target, deletes);
+            ESGeneration::bump(_name);
+            LOG_INFO("ES索引 {} 迁移完成，共复制 {} 条文档，别名已切换到 {}", _name, copied(), target);
+        }
+        else
+            LOG_ERROR("ES索引 {} 迁移到 {} 失败，别名未切换", _name, target);
+        return ret;
+    }
+
+    // 别名只能指向一个索引；name 不是别名但存在同名索引时视为旧的普通索引
+    bool resolveSource(std::string& source, bool& is_alias)
+    {
+        try
+        {
+            auto rsp = _client->performRequest(elasticlient::Client::HTTPMethod::GET, "_alias/" + _name, "");
+            if(rsp.status_code >= 200 && rsp.status_code < 300)
+            {
+                Json::Value result;
+                if(UnSerialize(rsp.text, result) == false || result.size() != 1)
+                {
+                    LOG_ERROR("ES别名 {} 指向的索引不唯一: {}", _name, rsp.text);
+                    return false;
+                }
+                source = result.getMemberNames()[0];
+                is_alias = true;
+                return true;
+            }
+            rsp = _client->performRequest(elasticlient::Client::HTTPMethod::HEAD, _name, "");
+            if(rsp.status_code >= 200 && rsp.status_code < 300)
+            {
+                source = _name;
+                is_alias = false;
+                return true;
+            }
+            LOG_ERROR("ES索引 {} 不存在, 响应状态码: {}", _name, rsp.status_code);
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR("查询ES别名 {} 失败：{}", _name, e.what());
+        }
+        return false;
+    }
+
+    // 按 _doc 顺序 scroll 读取，每批转换为 create 操作写入新索引，已存在的文档(双写进来的较新数据)跳过
+    bool copy(const std::string& source, const std::string& target)
+    {
+        Json::Value query;
+        query["size"] = (Json::UInt64)_options.batch_size;
+        query["sort"].append("_doc");
+        std::string body;
+        Serialize(query, body);
+        std::string path = source + "/_search?scroll=" + _options.scroll;
+        std::string scroll_id;
+        auto start = std::chrono::steady_clock::now();
+        size_t base = copied();
+        bool ret = false;
+        while(true)
+        {
+            Json::Value result;
+            if(request(elasticlient::Client::HTTPMethod::POST, path, body, result) == false)
+                break;
+            scroll_id = result["_scroll_id"].asString();
+            const Json::Value& hits = result["hits"]["hits"];
+            if(hits.empty())
+            {
+                ret = true;
+                break;
+            }
+            if(sendBatch(target, hits) == false)
+                break;
+            _copied.fetch_add(hits.size(), std::memory_order_relaxed);
+            if(throttle(start, copied() - base) == false)
+                break;
+            Json::Value next;
+            next["scroll"] = _options.scroll;
+            next["scroll_id"] = scroll_id;
+            Serialize(next, body);
+            path = "_search/scroll";
+        }
+        if(!scroll_id.empty())
+        {
+            Json::Value clear;
+            clear["scroll_id"].append(scroll_id);
+            Serialize(clear, body);
+            Json::Value ignored;
+            request(elasticlient::Client::HTTPMethod::DELETE, "_search/scroll", body, ignored);
+        }
+        return ret;
+    }
+
+    bool sendBatch(const std::string& target, const Json::Value& hits)
+    {
+        std::string bulk, line;
+        for(const auto& hit : hits)
+        {
+            Json::Value meta;
+            meta["_index"] = target;
+            meta["_type"] = _type;
+            meta["_id"] = hit["_id"];
+            if(hit.isMember("_routing"))
+                meta["routing"] = hit["_routing"];
+            Json::Value action;
+            action["create"] = meta;
+            Serialize(action, line);
+            bulk.append(line).push_back('\n');
+            Serialize(hit["_source"], line);
+            bulk.append(line).push_back('\n');
+        }
+        for(int attempt = 0; attempt <= _options.max_retries; ++attempt)
+        {
+            if(attempt > 0 && sleep(std::chrono::milliseconds(100 << std::min(attempt, 6))) == false)
+                return false;
+            Json::Value result;
+            if(request(elasticlient::Client::HTTPMethod::POST, "_bulk", bulk, result) == false)
+                continue;
+            if(result["errors"].asBool() == false)
+                return true;
+            for(const auto& item : result["items"])
+            {
+                const Json::Value& create = item["create"];
+                int status = create["status"].asInt();
+                // 409: 新索引中已有双写进来的数据
+                if((status >= 200 && status < 300) || status == 409)
+                    continue;
+                LOG_ERROR("迁移文档 {} 到 {} 失败, 状态码: {}, 原因: {}", create["_id"].asString(), target, status, create["error"].toStyledString());
+                return false;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // 修复双写失败的文档、重放删除，再比较两边的文档数；新索引较少(如其他进程在复制开始后写入了旧索引)时补充复制，
+    // 补充复制同样使用 create，已有的文档跳过
+    bool settle(const std::string& source, const std::string& target)
+    {
+        for(int round = 0; ; ++round)
+        {
+            if(repair(source, target, ESMigration::takeRepairs(_name)) == false
+                || replayDeletes(target, ESMigration::takeDeletes(_name)) == false)
+                return false;
+            // 双写先写旧索引，先统计旧索引，统计之后的双写只会让新索引更多
+            int64_t source_count, target_count;
+            if(refresh(source) == false || count(source, source_count) == false
+                || refresh(target) == false || count(target, target_count) == false)
+                return false;
+            if(target_count >= source_count)
+                return true;
+            if(round >= _options.verify_rounds)
+            {
+                LOG_ERROR("ES索引 {} 迁移目标 {} 文档数 {} 少于 {} 的 {}", _name, target, target_count, source, source_count);
+                return false;
+            }
+            LOG_WARN("ES索引 {} 迁移目标 {} 文档数 {} 少于 {} 的 {}，补充复制", _name, target, target_count, source, source_count);
+            if(copy(source, target) == false)
+                return false;
+        }
+    }
+
+    // 按旧索引修复新索引中的文档：先删除，再以 create 写入旧索引中的当前内容，期间双写进来的较新数据不会被覆盖
+    bool repair(const std::string& source, const std::string& target, const std::vector<ESMigration::DocRef>& docs)
+    {
+        for(const auto& doc : docs)
+        {
+            Json::Value hits(Json::arrayValue);
+            try
+            {
+                auto rsp = _client->remove(target, _type, doc.id, doc.routing);
+                if((rsp.status_code < 200 || rsp.status_code >= 300) && rsp.status_code != 404)
+                {
+                    LOG_ERROR("迁移目标 {} 修复文档 {} 失败, 响应状态码异常: {}", target, doc.id, rsp.status_code);
+                    return false;
+                }
+                rsp = _client->get(source, _type, doc.id, doc.routing);
+                if(rsp.status_code >= 200 && rsp.status_code < 300)
+                {
+                    Json::Value hit;
+                    if(UnSerialize(rsp.text, hit) == false)
+                    {
+                        LOG_ERROR("迁移目标 {} 修复文档 {} 失败, 响应反序列化失败", target, doc.id);
+                        return false;
+                    }
+                    hits.append(hit);
+                }
+                else if(rsp.status_code != 404)
+                {
+                    LOG_ERROR("迁移目标 {} 修复文档 {} 失败, 读取 {} 响应状态码异常: {}", target, doc.id, source, rsp.status_code);
+                    return false;
+                }
+            }
+            catch(const std::exception& e)
+            {
+                LOG_ERROR("迁移目标 {} 修复文档 {} 失败：{}", target, doc.id, e.what());
+                return false;
+            }
+            // 旧索引中已不存在时只需删除
+            if(!hits.empty() && sendBatch(target, hits) == false)
+                return false;
+        }
+        return true;
+    }
+
+    bool refresh(const std::string& index)
+    {
+        Json::Value ignored;
+        return request(elasticlient::Client::HTTPMethod::POST, index + "/_refresh", "", ignored);
+    }
+
+    bool count(const std::string& index, int64_t& count)
+    {
+        Json::Value result;
+        if(request(elasticlient::Client::HTTPMethod::GET, index + "/_count", "", result) == false)
+            return false;
+        count = result["count"].asInt64();
+        return true;
+    }
+
+    bool replayDeletes(const std::string& target, const std::vector<ESMigration::DocRef>& deletes)
+    {
+        for(const auto& del : deletes)
+        {
+            try
+            {
+                auto rsp = _client->remove(target, _type, del.id, del.routing);
+                if((rsp.status_code < 200 || rsp.status_code >= 300) && rsp.status_code != 404)
+                {
+                    LOG_ERROR("迁移目标 {} 重放删除 {} 失败, 响应状态码异常: {}", target, del.id, rsp.status_code);
+                    return false;
+                }
+            }
+            catch(const std::exception& e)
+            {
+                LOG_ERROR("迁移目标 {} 重放删除 {} 失败：{}", target, del.id, e.what());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 同一个 _aliases 请求中的操作原子生效，切换过程中搜索不会落空
+    bool swap(const std::string& source, bool is_alias, const std::string& target)
+    {
+        Json::Value add, remove, root;
+        add["add"]["index"] = target;
+        add["add"]["alias"] = _name;
+        root["actions"].append(add);
+        if(is_alias)
+        {
+            remove["remove"]["index"] = source;
+            remove["remove"]["alias"] = _name;
+        }
+        else
+            remove["remove_index"]["index"] = source;
+        root["actions"].append(remove);
+        std::string body;
+        Serialize(root, body);
+        Json::Value result;
+        return request(elasticlient::Client::HTTPMethod::POST, "_aliases", body, result);
+    }
+
+    // 按速率上限计算本批之后应到达的时间点并等待，copied 为本次复制开始以来的文档数
+    bool throttle(std::chrono::steady_clock::time_point start, size_t copied)
+    {
+        if(_options.max_docs_per_second <= 0)
+            return sleep(std::chrono::steady_clock::duration::zero());
+        auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(copied / _options.max_docs_per_second));
+        return sleep(due - std::chrono::steady_clock::now());
+    }
+
+    // 可被析构中止的等待，中止时返回 false
+    bool sleep(std::chrono::steady_clock::duration duration)
+    {
+        std::unique_lock lock(_mutex);
+        if(duration > std::chrono::steady_clock::duration::zero())
+            _cond.wait_for(lock, duration, [this](){ return _stop; });
+        return !_stop;
+    }
+
+    bool request(elasticlient::Client::HTTPMethod method, const std::string& path, const std::string& body, Json::Value& result)
+    {
+        try
+        {
+            auto rsp = _client->performRequest(method, path, body);
+            if(rsp.status_code < 200 || rsp.status_code >= 300)
+            {
+                LOG_ERROR_RL("ES请求 {} 失败, 响应状态码异常: {} {}", path, rsp.status_code, rsp.text);
+                return false;
+            }
+            if(rsp.text.empty())
+                return true;
+            return UnSerialize(rsp.text, result);
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR_RL("ES请求 {} 失败：{}", path, e.what());
+            return false;
+        }
+    }
+
+private:
+    std::string _name;
+    std::string _type;
+    std::shared_ptr<elasticlient::Client> _client;
+    ESReindexOptions _options;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _stop;
+    bool _result;
+    std::atomic<size_t> _copied;
+    std::thread _thread;
+};
+
+struct ESResponse
+{
+    long status_code = 0; // 0 表示请求未完成(连接失败、超时等)，原因见 error
+    std::string text;
+    std::string error;
+};
+
+// 异步 ES 客户端
+// 基于 curl multi：所有请求由一个事件线程驱动，调用方线程不阻塞；multi 句柄内部按节点缓存 keep-alive 连接，
+// 每个节点最多 max_connections_per_host 个连接，超出的请求在 curl 内部排队
+// 请求按轮转选择节点，连接失败时换下一个节点重试
+// 只用于搜索等读请求：写入须经 ESInsert/ESRemove/ESBulkWriter，才能使搜索缓存失效、通知写入回调并在迁移期间双写
+class ESAsyncClient
+{
+public:
+    using ptr = std::shared_ptr<ESAsyncClient>;
+    using Callback = std::function<void(ESResponse&&)>;
+
+    // hosts 形如 "http://127.0.0.1:9200/"
+    ESAsyncClient(const std::vector<std::string>& hosts, long max_connections_per_host = 16, long timeout_ms = 6000)
+    : _hosts(hosts), _timeout_ms(timeout_ms), _next_host(0), _running(true)
+    {
+        for(auto& host : _hosts)
+        {
+            if(host.empty() || host.back() != '/')
+                host.push_back('/');
+        }
+        globalInit();
+        _multi = curl_multi_init();
+        curl_multi_setopt(_multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_connections_per_host);
+        curl_multi_setopt(_multi, CURLMOPT_MAXCONNECTS, max_connections_per_host * (long)_hosts.size());
+        _headers = curl_slist_append(nullptr, "Content-Type: application/json");
+        _loop_thread = std::thread(&ESAsyncClient::loop, this);
+    }
+
+    ~ESAsyncClient()
+    {
+        {
+            std::unique_lock lock(_mutex);
+            _running = false;
+        }
+        curl_multi_wakeup(_multi);
+        _loop_thread.join();
+        for(CURL* easy : _idle)
+            curl_easy_cleanup(easy);
+        curl_slist_free_all(_headers);
+        curl_multi_cleanup(_multi);
+    }
+
+    // path 为相对节点地址的路径，如 "user/_doc/_search"；回调在事件线程中执行，不应做耗时操作
+    void request(const std::string& method, const std::string& path, const std::string& body, const Callback& cb)
+    {
+        auto req = std::make_unique<Request>();
+        req->method = method;
+        req->path = path;
+        req->body = body;
+        req->cb = cb;
+        {
+            std::unique_lock lock(_mutex);
+            if(_running)
+            {
+                _pending.push_back(std::move(req));
+                req.reset();
+            }
+        }
+        if(req)
+        {
+            cb(ESResponse{0, "", "客户端已停止"});
+            return;
+        }
+        curl_multi_wakeup(_multi);
+    }
+
+    std::future<ESResponse> request(const std::string& method, const std::string& path, const std::string& body)
+    {
+        auto promise = std::make_shared<std::promise<ESResponse>>();
+        std::future<ESResponse> future = promise->get_future();
+        request(method, path, body, [promise](ESResponse&& rsp){
+            promise->set_value(std::move(rsp));
+        });
+        return future;
+    }
+
+    std::future<ESResponse> search(const std::string& index, const std::string& type, const std::string& body)
+    {
+        return request("GET", index + "/" + type + "/_search", body);
+    }
+private:
+    // curl_global_init 不是线程安全的，每个进程只调用一次，进程退出前不清理(cpr/elasticlient 可能仍在使用 curl)
+    // 第一个 ESAsyncClient 应在启动阶段、其他线程开始使用 curl 之前创建
+    static void globalInit()
+    {
+        static const bool inited = [](){
+            CURLcode code = curl_global_init(CURL_GLOBAL_DEFAULT);
+            if(code != CURLE_OK)
+                LOG_ERROR("curl 全局初始化失败: {}", curl_easy_strerror(code));
+            return code == CURLE_OK;
+        }();
+        (void)inited;
+    }
+
+    struct Request
     {
-        Json::Value fields;
-        fields["type"] = type;
-        fields["analyzer"] = analyzer;
-        if(enabled == false)
-            fields["enabled"] = enabled;
-        
-        _properties[key] = fields;
+        std::string method;
+        std::string path;
+        std::string body;
+        Callback cb;
+        std::string url;
+        ESResponse response;
+        size_t attempts = 0;
+        size_t host = 0;
+        CURL* easy = nullptr;
+    };
 
-        return *this;
+    static size_t onData(char* data, size_t size, size_t nmemb, void* userdata)
+    {
+        static_cast<Request*>(userdata)->response.text.append(data, size * nmemb);
+        return size * nmemb;
     }
 
-    bool create(const std::string& index_id = "default_index_id")
+    // 在事件线程中调用
+    void start(std::unique_ptr<Request> req)
     {
-        // 1. 序列化
-        Json::Value mappings;
-        mappings["dynamic"] = true;
-        mappings["properties"] = _properties;
-        _index["mappings"] = mappings;
-
-        std::string body;
-        bool ret = Serialize(_index, body);
-        if(ret == false)
+        // 首次按轮转选择节点，重试时换到下一个节点
+        req->host = req->attempts == 0 ? _next_host++ % _hosts.size() : (req->host + 1) % _hosts.size();
+        req->url = _hosts[req->host] + req->path;
+        req->response = ESResponse();
+        ++req->attempts;
+        CURL* easy;
+        if(_idle.empty())
+            easy = curl_easy_init();
+        else
         {
-            LOG_ERROR("索引序列化失败!");
-            return false;
+            easy = _idle.back();
+            _idle.pop_back();
+            curl_easy_reset(easy);
+        }
+        req->easy = easy;
+        curl_easy_setopt(easy, CURLOPT_URL, req->url.c_str());
+        curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, req->method.c_str());
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, _headers);
+        if(!req->body.empty())
+        {
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDS, req->body.data());
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, (long)req->body.size());
         }
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &ESAsyncClient::onData);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, req.get());
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, _timeout_ms);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, req.get());
+        curl_multi_add_handle(_multi, easy);
+        _active.push_back(std::move(req));
+    }
 
-        // 2. 发起创建索引请求
-        try
+    void finish(CURL* easy, CURLcode code)
+    {
+        Request* raw = nullptr;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, &raw);
+        curl_multi_remove_handle(_multi, easy);
+        _idle.push_back(easy);
+        auto it = std::find_if(_active.begin(), _active.end(), [raw](const auto& req){ return req.get() == raw; });
+        std::unique_ptr<Request> req = std::move(*it);
+        _active.erase(it);
+        if(code == CURLE_OK)
+            curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &req->response.status_code);
+        else
         {
-            auto rsp = _client->index(_name, _type, index_id, body);
-            if(rsp.status_code < 200 || rsp.status_code >= 300)
+            req->response.error = curl_easy_strerror(code);
+            // 连接不上时换一个节点重试，已经发出的请求可能已被执行，不重试
+            if(code == CURLE_COULDNT_CONNECT && req->attempts < _hosts.size())
             {
-                LOG_ERROR("创建ES索引 {} 失败, 响应状态码异常: {}", _name, rsp.status_code);
-                return false;
+                _restarted = true;
+                start(std::move(req));
+                return;
             }
         }
-        catch(const std::exception& e)
+        req->cb(std::move(req->response));
+    }
+
+    void loop()
+    {
+        while(true)
         {
-            LOG_ERROR("创建ES索引 {} 失败：{}", _name, e.what());
-            return false;
+            std::deque<std::unique_ptr<Request>> pending;
+            bool running;
+            {
+                std::unique_lock lock(_mutex);
+                pending.swap(_pending);
+                running = _running;
+            }
+            for(auto& req : pending)
+                start(std::move(req));
+            // 停止时等待已发出的请求全部完成
+            if(!running && _active.empty())
+                return;
+            _restarted = false;
+            int still_running = 0;
+            curl_multi_perform(_multi, &still_running);
+            CURLMsg* msg;
+            int left;
+            while((msg = curl_multi_info_read(_multi, &left)) != nullptr)
+            {
+                if(msg->msg == CURLMSG_DONE)
+                    finish(msg->easy_handle, msg->data.result);
+            }
+            // 有请求换节点重试时立即驱动，不等待
+            if(!_restarted)
+                curl_multi_poll(_multi, nullptr, 0, 1000, nullptr);
         }
-        return true;
     }
+
 private:
-    std::string _name;
-    std::string _type;
-    Json::Value _properties;
-    Json::Value _index;
-    std::shared_ptr<elasticlient::Client> _client;
+    std::vector<std::string> _hosts;
+    long _timeout_ms;
+    size_t _next_host;
+    bool _restarted = false;
+    CURLM* _multi;
+    struct curl_slist* _headers;
+    std::vector<CURL*> _idle; // 可复用的 easy 句柄
+    std::list<std::unique_ptr<Request>> _active; // 已交给 curl 的请求，只在事件线程中访问
+
+    std::mutex _mutex;
+    bool _running;
+    std::deque<std::unique_ptr<Request>> _pending; // 等待事件线程发出的请求
+    std::thread _loop_thread;
 };
 
-class ESInsert
+// 搜索结果的流式解码：直接遍历响应中的 hits.hits[]，把 _source 中登记过的字段填入 T，未登记的字段直接跳过，不构建 Json::Value
+// 用法：
+//     ESHitDecoder<Message> decoder;
+//     decoder.id(&Message::message_id).field("content", &Message::content)
+//            .field("create_time", [](Message& m, JsonReader& r){ int64_t t; if(!r.read(t)) return false; m.set_time(t); return true; });
+// 值为 null 的字段保持 T 的默认值
+template<typename T>
+class ESHitDecoder
 {
 public:
-    ESInsert(std::shared_ptr<elasticlient::Client>& client, const std::string& name, const std::string& type)
-    :_name(name),_type(type),_client(client)
-    {}
+    using FieldReader = std::function<bool(T&, JsonReader&)>;
 
-    ESInsert& append(const std::string& key, const std::string& val)
+    // 成员类型须为 JsonReader::read 支持的类型(std::string、整数、double、bool)
+    template<typename V>
+    ESHitDecoder& field(const std::string& name, V T::*member)
     {
-        _item[key] = val;
+        return field(name, FieldReader([member](T& obj, JsonReader& reader){
+            return reader.read(obj.*member);
+        }));
+    }
+
+    // 自定义读取，用于 protobuf 消息等需要通过 setter 赋值的类型
+    ESHitDecoder& field(const std::string& name, FieldReader reader)
+    {
+        _fields.emplace_back(name, std::move(reader));
         return *this;
     }
 
-    bool insert(const std::string& id = "")
+    // 文档 ID(_id)
+    ESHitDecoder& id(std::string T::*member)
     {
-        std::string body;
-        bool ret = Serialize(_item, body);
-        if(ret == false)
-        {
-            LOG_ERROR("索引序列化失败!");
-            return false;
-        }
+        return hit("_id", FieldReader([member](T& obj, JsonReader& reader){
+            return reader.read(obj.*member);
+        }));
+    }
 
-        // 2. 发起新增数据请求
-        try
+    // 文档所在的索引(_index)，按月分区时即文档所在的分区，修改/删除往月文档时传给 ESInsert/ESRemove::partition
+    ESHitDecoder& index(std::string T::*member)
+    {
+        return hit("_index", FieldReader([member](T& obj, JsonReader& reader){
+            return reader.read(obj.*member);
+        }));
+    }
+
+    // hits.hits[] 中 _source 以外的键，如 _score、sort
+    ESHitDecoder& hit(const std::string& key, FieldReader reader)
+    {
+        _hit_fields.emplace_back(key, std::move(reader));
+        return *this;
+    }
+
+    // 登记过的 _source 字段名，ESSearch 用来设置 _source 投影
+    std::vector<std::string> fields() const
+    {
+        std::vector<std::string> names;
+        for(const auto& field : _fields)
+            names.push_back(field.first);
+        return names;
+    }
+
+    // 解码结果追加到 out，失败时 out 中可能已有部分结果
+    bool decode(const char* data, size_t size, std::vector<T>& out, std::string& err) const
+    {
+        JsonReader reader(data, size);
+        std::string_view key;
+        // 没有命中时 filter_path 过滤后的响应为空对象
+        if(reader.beginObject())
         {
-            auto rsp = _client->index(_name, _type, id, body);
-            if(rsp.status_code < 200 || rsp.status_code >= 300)
+            while(reader.nextMember(key))
             {
-                LOG_ERROR("新增数据 {} 失败, 响应状态码异常: {}", body, rsp.status_code);
-                return false;
+                if(key != "hits")
+                {
+                    reader.skip();
+                    continue;
+                }
+                if(!reader.beginObject())
+                    break;
+                while(reader.nextMember(key))
+                {
+                    if(key != "hits")
+                        reader.skip();
+                    else if(!decodeHits(reader, out))
+                        break;
+                }
             }
         }
-        catch(const std::exception& e)
+        if(!reader.ok())
         {
-            LOG_ERROR("新增数据 {} 失败：{}", body, e.what());
+            err = reader.error();
             return false;
         }
         return true;
     }
-
 private:
-    std::string _name;
-    std::string _type;
-    Json::Value _item;
-    std::shared_ptr<elasticlient::Client> _client;
-};
-
-class ESRemove
-{
-public:
-    ESRemove(std::shared_ptr<elasticlient::Client>& client, const std::string& name, const std::string& type)
-    :_name(name),_type(type),_client(client)
-    {}
+    using Fields = std::vector<std::pair<std::string, FieldReader>>;
 
-    bool remove(const std::string& id)
+    bool decodeHits(JsonReader& reader, std::vector<T>& out) const
     {
-        try
+        if(!reader.beginArray())
+            return false;
+        std::string_view key;
+        while(reader.nextElement())
         {
-            auto rsp = _client->remove(_name, _type, id);
-            if(rsp.status_code < 200 || rsp.status_code >= 300)
-            {
-                LOG_ERROR("删除数据 {} 失败, 响应状态码异常: {}", id, rsp.status_code);
+            if(!reader.beginObject())
                 return false;
+            T& obj = out.emplace_back();
+            while(reader.nextMember(key))
+            {
+                if(key != "_source")
+                {
+                    if(!readField(_hit_fields, key, obj, reader))
+                        return false;
+                    continue;
+                }
+                if(!reader.beginObject())
+                    return false;
+                while(reader.nextMember(key))
+                {
+                    if(!readField(_fields, key, obj, reader))
+                        return false;
+                }
             }
+            if(!reader.ok())
+                return false;
         }
-        catch(const std::exception& e)
+        return reader.ok();
+    }
+
+    // 字段一般只有几个，顺序比较比哈希查找更快
+    static bool readField(const Fields& fields, std::string_view key, T& obj, JsonReader& reader)
+    {
+        for(const auto& field : fields)
         {
-            LOG_ERROR("删除数据 {} 失败：{}", id, e.what());
-            return false;
+            if(field.first == key)
+                return reader.readNull() || field.second(obj, reader);
         }
-        return true;
+        return reader.skip();
     }
+
 private:
-    std::string _name;
-    std::string _type; 
-    std::shared_ptr<elasticlient::Client> _client;
+    Fields _fields;
+    Fields _hit_fields;
 };
 
-
 class ESSearch
 {
 public:
@@ -223,60 +2136,392 @@ public:
         return *this;
     }
 
+    // 以下条件放在 bool.filter 中：只判断是否命中、不参与打分，ES 会缓存其结果
+    // 精确匹配，用于 keyword 等不分词的字段，如 chat_session_id、user_id
+    ESSearch& append_filter_term(const std::string& key, const Json::Value& val)
+    {
+        Json::Value fields;
+        fields[key] = val;
+        Json::Value term;
+        term["term"] = fields;
+        _filter.append(term);
+        return *this;
+    }
+
+    // 范围匹配，gte/lte 为 null 时表示该侧不限制
+    ESSearch& append_filter_range(const std::string& key, const Json::Value& gte, const Json::Value& lte = Json::Value())
+    {
+        Json::Value bounds(Json::objectValue);
+        if(!gte.isNull())
+            bounds["gte"] = gte;
+        if(!lte.isNull())
+            bounds["lte"] = lte;
+        Json::Value fields;
+        fields[key] = bounds;
+        Json::Value range;
+        range["range"] = fields;
+        _filter.append(range);
+        return *this;
+    }
+
+    // 前缀匹配，用于不分词的字段
+    ESSearch& append_prefix(const std::string& key, const std::string& val)
+    {
+        Json::Value fields;
+        fields[key] = val;
+        Json::Value prefix;
+        prefix["prefix"] = fields;
+        _filter.append(prefix);
+        return *this;
+    }
+
+    // 必须命中的全文匹配，参与打分
+    ESSearch& append_must_match(const std::string& key, const std::string& val)
+    {
+        Json::Value fields;
+        fields[key] = val;
+        Json::Value match;
+        match["match"] = fields;
+        _must.append(match);
+        return *this;
+    }
+
+    // 只查询该路由值所在的分片，须与写入时的路由值一致
+    ESSearch& routing(const std::string& routing)
+    {
+        _routing = routing;
+        return *this;
+    }
+
+    // 目标为按月分区的索引(见 ESPartition)，存在 time_field 上的 append_filter_range 条件时只查询与该时间范围有交集的分区
+    ESSearch& partitioned(const std::string& time_field)
+    {
+        _partition_field = time_field;
+        return *this;
+    }
+
+    // 输入即搜索：在 ESIndex::append 指定的 prefix/pinyin 子字段上做前缀匹配，输入中以空白分隔的每一段都须命中
+    // 前缀已在写入时展开为词项，查询只需词项查找；原文前缀的命中排在拼音命中之前
+    ESSearch& append_typeahead(const std::string& key, const std::string& input)
+    {
+        Json::Value fields(Json::arrayValue);
+        fields.append(key + "." + ESIndex::PREFIX_FIELD + "^2");
+        fields.append(key + "." + ESIndex::PINYIN_FIELD);
+        Json::Value multi_match;
+        multi_match["query"] = input;
+        multi_match["fields"] = fields;
+        multi_match["operator"] = "and";
+        Json::Value query;
+        query["multi_match"] = multi_match;
+        _must.append(query);
+        return *this;
+    }
+
+    // 跳过搜索结果缓存，用于必须读到最新数据的场景
+    ESSearch& nocache()
+    {
+        _use_cache = false;
+        return *this;
+    }
+
+    // 只返回 _source 中的指定字段
+    ESSearch& source(const std::vector<std::string>& fields)
+    {
+        _source = Json::Value(Json::arrayValue);
+        for(const auto& field : fields)
+            _source.append(field);
+        return *this;
+    }
+
+    // 返回的结果条数，不设置时使用 ES 的默认值(10)
+    ESSearch& size(int size)
+    {
+        _size = std::clamp(size, 0, MAX_RESULT_WINDOW);
+        return *this;
+    }
+
+    // 跳过前 from 条结果，from + size 不能超过 MAX_RESULT_WINDOW，更深的翻页使用 search_after
+    ESSearch& from(int from)
+    {
+        _from = std::clamp(from, 0, MAX_RESULT_WINDOW);
+        return *this;
+    }
+
+    // 按字段排序，可多次调用；使用 search_after 时排序键必须能唯一确定一条文档(如最后加上 ID 字段)
+    ESSearch& sort(const std::string& field, bool asc = true)
+    {
+        Json::Value order;
+        order[field]["order"] = asc ? "asc" : "desc";
+        _sort.append(order);
+        return *this;
+    }
+
+    // 从上一页最后一条结果的 sort 值之后继续取，sort_values 即该结果的 "sort" 字段
+    ESSearch& search_after(const Json::Value& sort_values)
+    {
+        _search_after = sort_values;
+        return *this;
+    }
+
     Json::Value search()
+    {
+        std::string body;
+        if(buildBody(body) == false)
+            return false;
+        ESSearchCache::ptr cache = _use_cache ? g_es_search_cache : ESSearchCache::ptr();
+        uint64_t generation = ESGeneration::get(_name);
+        std::string key = cacheKey(body);
+        Json::Value cached;
+        if(cache && cache->get(_name, key, cached))
+            return cached;
+
+        // 2. 发起搜索请求
+        cpr::Response rsp;
+        if(fetch(body, rsp) == false)
+            return Json::Value();
+
+        // 3. 对响应正文进行反序列化
+        return parseHits(_name, rsp.text, cache, key, generation);
+    }
+
+    // 搜索并把命中结果直接解码为 T 追加到 out，不经过 Json::Value，适合结果条数多、只取部分字段的搜索
+    // 未调用 source() 时只向 ES 请求 decoder 登记过的字段；结果不读写搜索缓存
+    template<typename T>
+    bool search_as(const ESHitDecoder<T>& decoder, std::vector<T>& out)
+    {
+        if(_source.isNull() && !decoder.fields().empty())
+            source(decoder.fields());
+        std::string body;
+        if(buildBody(body) == false)
+            return false;
+        cpr::Response rsp;
+        if(fetch(body, rsp) == false)
+            return false;
+        std::string err;
+        if(decoder.decode(rsp.text.data(), rsp.text.size(), out, err) == false)
+        {
+            LOG_ERROR_RL("检索数据 {} 结果解码失败: {}", body, err);
+            return false;
+        }
+        return true;
+    }
+
+    // 通过异步客户端发起搜索，立即返回；响应在调用 future::get 的线程中解析，结果与 search() 相同
+    // 多个搜索可以先全部发出再依次等待结果
+    std::future<Json::Value> search_async(const ESAsyncClient::ptr& client)
+    {
+        std::string body;
+        if(buildBody(body) == false)
+            return readyFuture(Json::Value(false));
+        ESSearchCache::ptr cache = _use_cache ? g_es_search_cache : ESSearchCache::ptr();
+        uint64_t generation = ESGeneration::get(_name);
+        std::string key = cacheKey(body);
+        Json::Value cached;
+        if(cache && cache->get(_name, key, cached))
+            return readyFuture(std::move(cached));
+        std::shared_future<ESResponse> rsp = client->request("GET", searchPath(), body).share();
+        // 调用方通常不会保留 ESSearch 对象，这里只捕获值
+        return std::async(std::launch::deferred, [name = _name, rsp, cache, body, key, generation](){
+            const ESResponse& result = rsp.get();
+            if(result.status_code < 200 || result.status_code >= 300)
+            {
+                LOG_ERROR_RL("检索数据 {} 失败, 响应状态码异常: {} {}", body, result.status_code, result.error);
+                return Json::Value();
+            }
+            return parseHits(name, result.text, cache, key, generation);
+        });
+    }
+
+private:
+    bool buildBody(std::string& body)
     {
         Json::Value cond;
         if(!_must_not.empty())
             cond["must_not"] = _must_not;
         if(!_should.empty())
             cond["should"] = _should;
+        if(!_must.empty())
+            cond["must"] = _must;
+        if(!_filter.empty())
+            cond["filter"] = _filter;
+        // 存在 must/filter 时 should 默认变为可选，这里保持只有 should 时"至少命中一条"的语义
+        if(!_should.empty() && (!_must.empty() || !_filter.empty()))
+            cond["minimum_should_match"] = 1;
 
         Json::Value query;
         query["bool"] = cond;
         Json::Value root;
         root["query"] = query;
+        if(!_source.isNull())
+            root["_source"] = _source;
+        if(_size >= 0)
+            root["size"] = std::min(_size, MAX_RESULT_WINDOW - std::max(_from, 0));
+        if(_from > 0)
+            root["from"] = _from;
+        if(!_sort.empty())
+            root["sort"] = _sort;
+        if(!_search_after.empty())
+            root["search_after"] = _search_after;
 
-        std::string body;
         bool ret = Serialize(root, body);
         if(ret == false)
         {
             LOG_ERROR("索引序列化失败!");
             return false;
         }
+        return true;
+    }
 
-        // 2. 发起搜索请求
-        cpr::Response rsp;
+    bool fetch(const std::string& body, cpr::Response& rsp)
+    {
         try
         {
-            rsp = _client->search(_name, _type, body);
+            rsp = _client->performRequest(elasticlient::Client::HTTPMethod::GET, searchPath(), body);
             if(rsp.status_code < 200 || rsp.status_code >= 300)
             {
-                LOG_ERROR("检索数据 {} 失败, 响应状态码异常: {}", body, rsp.status_code);
-                return Json::Value();
-            }     
+                LOG_ERROR_RL("检索数据 {} 失败, 响应状态码异常: {}", body, rsp.status_code);
+                return false;
+            }
         }
         catch(const std::exception& e)
         {
-            LOG_ERROR("检索数据 {} 失败：{}", body, e.what());
-            return Json::Value();
+            LOG_ERROR_RL("检索数据 {} 失败：{}", body, e.what());
+            return false;
+        }
+        return true;
+    }
+
+    // filter_path 让 ES 只返回命中结果中用到的部分，不返回 took/_shards/total 等元信息
+    std::string searchPath() const
+    {
+        std::string path;
+        std::vector<std::string> partitions = prunedPartitions();
+        if(partitions.empty())
+            path = _name + "/" + _type + "/_search?filter_path=" + FILTER_PATH;
+        else
+        {
+            for(const auto& partition : partitions)
+                path.append(partition).push_back(',');
+            path.back() = '/';
+            // 范围内可能有尚未创建的分区
+            path += _type + "/_search?ignore_unavailable=true&allow_no_indices=true&filter_path=" + FILTER_PATH;
         }
+        if(!_routing.empty())
+            path += "&routing=" + urlEncode(_routing);
+        return path;
+    }
 
-        // 3. 对响应正文进行反序列化
+    // 路由值由调用方传入，可能含有 &、#、空格等在查询串中有特殊含义的字符
+    static std::string urlEncode(const std::string& str)
+    {
+        static const char* HEX = "0123456789ABCDEF";
+        std::string out;
+        out.reserve(str.size());
+        for(unsigned char c : str)
+        {
+            if(isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+                out.push_back(c);
+            else
+            {
+                out.push_back('%');
+                out.push_back(HEX[c >> 4]);
+                out.push_back(HEX[c & 0xF]);
+            }
+        }
+        return out;
+    }
+
+    // 从 filter 中找出分区时间字段上的范围条件，计算需要查询的分区；无法裁剪时返回空
+    // 范围两端各放宽 PARTITION_SLACK 秒，覆盖月份切换前后写入相邻分区的文档
+    std::vector<std::string> prunedPartitions() const
+    {
+        if(_partition_field.empty())
+            return std::vector<std::string>();
+        int64_t start = INT64_MIN, end = INT64_MAX;
+        bool found = false;
+        for(const auto& cond : _filter)
+        {
+            const Json::Value& bounds = cond["range"][_partition_field];
+            if(!bounds.isObject())
+                continue;
+            int64_t val;
+            if(toSeconds(bounds["gte"], val))
+                start = std::max(start, val);
+            if(toSeconds(bounds["lte"], val))
+                end = std::min(end, val);
+            found = true;
+        }
+        if(!found || start == INT64_MIN)
+            return std::vector<std::string>();
+        if(end == INT64_MAX)
+            end = time(nullptr);
+        if(start > end)
+            return std::vector<std::string>();
+        return ESPartition::indicesBetween(_name, start - PARTITION_SLACK, end + PARTITION_SLACK);
+    }
+
+    static bool toSeconds(const Json::Value& val, int64_t& seconds)
+    {
+        if(val.isIntegral())
+        {
+            seconds = val.asInt64();
+            return true;
+        }
+        if(!val.isString())
+            return false;
+        const std::string& str = val.asString();
+        auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), seconds);
+        return ec == std::errc() && end == str.data() + str.size();
+    }
+
+    // 路由值不在请求体中，但会影响结果；编码后的路由值不含换行，放在请求体之前，不同的路由值与请求体组合不会得到相同的键
+    std::string cacheKey(const std::string& body) const
+    {
+        return _routing.empty() ? body : "routing=" + urlEncode(_routing) + "\n" + body;
+    }
+
+    static Json::Value parseHits(const std::string& name, const std::string& text, const ESSearchCache::ptr& cache, const std::string& body, uint64_t generation)
+    {
         Json::Value json_res;
-        ret = UnSerialize(rsp.text, json_res);
+        bool ret = UnSerialize(text, json_res);
         if(ret == false)
         {
-            LOG_ERROR("检索数据 {}  结果反序列化失败", rsp.text);
+            LOG_ERROR("检索数据 {}  结果反序列化失败", text);
             return Json::Value();
         }
-        return json_res["hits"]["hits"];
+        // 没有命中时 filter_path 过滤后的响应为空对象
+        Json::Value hits = json_res["hits"]["hits"].isArray() ? json_res["hits"]["hits"] : Json::Value(Json::arrayValue);
+        if(cache)
+            cache->put(name, body, generation, hits);
+        return hits;
+    }
+
+    static std::future<Json::Value> readyFuture(Json::Value&& val)
+    {
+        std::promise<Json::Value> promise;
+        promise.set_value(std::move(val));
+        return promise.get_future();
     }
 
 private:
+    static constexpr int MAX_RESULT_WINDOW = 10000; // ES index.max_result_window 的默认值
+    static constexpr const char* FILTER_PATH = "hits.hits._index,hits.hits._id,hits.hits._score,hits.hits._source,hits.hits.sort";
+    static constexpr int64_t PARTITION_SLACK = 3600;
+
     std::string _name;
     std::string _type; 
     Json::Value _must_not;
     Json::Value _should;
+    Json::Value _must;
+    Json::Value _filter;
+    Json::Value _source;
+    int _size = -1;
+    int _from = 0;
+    Json::Value _sort;
+    Json::Value _search_after;
+    bool _use_cache = true;
+    std::string _routing;
+    std::string _partition_field;
     std::shared_ptr<elasticlient::Client> _client;
 };
 }
\ No newline at end of file
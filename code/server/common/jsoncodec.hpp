@@ -0,0 +1,632 @@
+#pragma once
+#include <json/json.h>
+#include <fmt/format.h>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+// Json 序列化/反序列化
+// StreamWriter/CharReader 按线程缓存，序列化结果直接写入调用方的 std::string，复用其已分配的容量
+// 定义 HMY_JSON_FAST_WRITER 后序列化改用 JsonFastWriter：直接遍历 Json::Value 拼接字符串，不经过 std::ostream，
+// 输出与 jsoncpp(emitUTF8、无缩进、17 位有效数字)一致
+// JsonReader 是不构建 Json::Value 的拉取式解析器，用于只需要从大响应中取少量字段的场景(见 icsearch.hpp 的 ESHitDecoder)
+namespace hmy{
+// 以追加方式写入 std::string 的流缓冲区
+class StringOutBuf : public std::streambuf
+{
+public:
+    void reset(std::string* dst)
+    {
+        _dst = dst;
+    }
+protected:
+    int_type overflow(int_type ch) override
+    {
+        if(ch != traits_type::eof())
+            _dst->push_back((char)ch);
+        return ch;
+    }
+    std::streamsize xsputn(const char* data, std::streamsize size) override
+    {
+        _dst->append(data, size);
+        return size;
+    }
+private:
+    std::string* _dst = nullptr;
+};
+
+// 线程局部缓存的 jsoncpp 读写器
+class JsonStreamCodec
+{
+public:
+    static bool write(const Json::Value& val, std::string& dst)
+    {
+        Writer& writer = threadWriter();
+        dst.clear();
+        writer.buf.reset(&dst);
+        int ret = writer.writer->write(val, &writer.out);
+        writer.out.flush();
+        writer.buf.reset(nullptr);
+        return ret == 0 && writer.out.good();
+    }
+
+    static bool read(const char* begin, const char* end, Json::Value& val, std::string& err)
+    {
+        thread_local std::unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+        return reader->parse(begin, end, &val, &err);
+    }
+private:
+    struct Writer
+    {
+        Writer()
+        : out(&buf)
+        {
+            Json::StreamWriterBuilder builder;
+            builder.settings_["emitUTF8"] = true;
+            builder.settings_["indentation"] = "";
+            writer.reset(builder.newStreamWriter());
+        }
+        StringOutBuf buf;
+        std::ostream out;
+        std::unique_ptr<Json::StreamWriter> writer;
+    };
+
+    static Writer& threadWriter()
+    {
+        thread_local Writer writer;
+        return writer;
+    }
+};
+
+// 直接把 Json::Value 拼接到 std::string，对象成员按键名有序输出(与 jsoncpp 相同)
+class JsonFastWriter
+{
+public:
+    static bool write(const Json::Value& val, std::string& dst)
+    {
+        dst.clear();
+        append(val, dst);
+        return true;
+    }
+private:
+    static void append(const Json::Value& val, std::string& dst)
+    {
+        switch(val.type())
+        {
+        case Json::nullValue:
+            dst.append("null");
+            break;
+        case Json::intValue:
+            dst.append(fmt::format_int(val.asLargestInt()).c_str());
+            break;
+        case Json::uintValue:
+            dst.append(fmt::format_int(val.asLargestUInt()).c_str());
+            break;
+        case Json::realValue:
+            appendDouble(val.asDouble(), dst);
+            break;
+        case Json::booleanValue:
+            dst.append(val.asBool() ? "true" : "false");
+            break;
+        case Json::stringValue:
+        {
+            const char* begin;
+            const char* end;
+            if(val.getString(&begin, &end))
+                appendString(begin, end, dst);
+            else
+                dst.append("\"\"");
+            break;
+        }
+        case Json::arrayValue:
+        {
+            dst.push_back('[');
+            Json::ArrayIndex size = val.size();
+            for(Json::ArrayIndex i = 0; i < size; ++i)
+            {
+                if(i > 0)
+                    dst.push_back(',');
+                append(val[i], dst);
+            }
+            dst.push_back(']');
+            break;
+        }
+        case Json::objectValue:
+        {
+            dst.push_back('{');
+            bool first = true;
+            for(auto it = val.begin(); it != val.end(); ++it)
+            {
+                if(!first)
+                    dst.push_back(',');
+                first = false;
+                const char* end;
+                const char* name = it.memberName(&end);
+                appendString(name, end, dst);
+                dst.push_back(':');
+                append(*it, dst);
+            }
+            dst.push_back('}');
+            break;
+        }
+        }
+    }
+
+    static void appendDouble(double val, std::string& dst)
+    {
+        if(!std::isfinite(val))
+        {
+            dst.append(std::isnan(val) ? "null" : (val < 0 ? "-1e+9999" : "1e+9999"));
+            return;
+        }
+        char buf[32];
+        int len = snprintf(buf, sizeof(buf), "%.17g", val);
+        dst.append(buf, len);
+        // 与 jsoncpp 一致，整数值的浮点数保留小数点
+        if(strpbrk(buf, ".e") == nullptr)
+            dst.append(".0");
+    }
+
+    static void appendString(const char* begin, const char* end, std::string& dst)
+    {
+        static const char hex[] = "0123456789abcdef";
+        dst.push_back('"');
+        const char* run = begin; // 尚未写出的、不需要转义的连续字节
+        for(const char* p = begin; p != end; ++p)
+        {
+            unsigned char c = *p;
+            if(c >= 0x20 && c != '"' && c != '\\')
+                continue;
+            dst.append(run, p - run);
+            run = p + 1;
+            switch(c)
+            {
+            case '"': dst.append("\\\""); break;
+            case '\\': dst.append("\\\\"); break;
+            case '\b': dst.append("\\b"); break;
+            case '\f': dst.append("\\f"); break;
+            case '\n': dst.append("\\n"); break;
+            case '\r': dst.append("\\r"); break;
+            case '\t': dst.append("\\t"); break;
+            default:
+                dst.append("\\u00");
+                dst.push_back(hex[c >> 4]);
+                dst.push_back(hex[c & 0xf]);
+            }
+        }
+        dst.append(run, end - run);
+        dst.push_back('"');
+    }
+};
+
+// 拉取式 Json 解析器：调用方按文档结构逐层读取，不关心的值用 skip() 跳过，不分配任何中间对象
+// 读取对象：
+//     if(reader.beginObject())
+//         while(reader.nextMember(key)) { if(key == "a") reader.read(a); else reader.skip(); }
+// 每个成员的值必须被读取或跳过恰好一次；数组用 beginArray/nextElement，用法相同
+// 只做读取所需的语法检查，出错后所有操作都返回 false，可通过 error() 查看出错位置
+class JsonReader
+{
+public:
+    JsonReader(const char* data, size_t size)
+    : _begin(data)
+    , _pos(data)
+    , _end(data + size)
+    {}
+
+    bool ok() const
+    {
+        return _error == nullptr;
+    }
+
+    std::string error() const
+    {
+        if(_error == nullptr)
+            return std::string();
+        return std::string(_error) + " (offset " + std::to_string(_pos - _begin) + ")";
+    }
+
+    // 下一个值的首字符，到达末尾或出错时为 0
+    char peek()
+    {
+        skipSpace();
+        return ok() && _pos < _end ? *_pos : 0;
+    }
+
+    bool beginObject()
+    {
+        return consume('{', "expect '{'");
+    }
+
+    // 读取下一个成员名，对象结束时返回 false；key 在下一次读取前有效
+    bool nextMember(std::string_view& key)
+    {
+        if(!nextItem('}'))
+            return false;
+        if(!parseString(key) || !consume(':', "expect ':'"))
+            return false;
+        return true;
+    }
+
+    bool beginArray()
+    {
+        return consume('[', "expect '['");
+    }
+
+    // 数组中还有元素时返回 true，之后应读取或跳过该元素
+    bool nextElement()
+    {
+        return nextItem(']');
+    }
+
+    // 当前值为 null 时读过它并返回 true
+    bool readNull()
+    {
+        if(peek() != 'n')
+            return false;
+        return literal("null");
+    }
+
+    // 字符串原样读取，数字/布尔值读取其字面量文本(与 Json::Value::asString 一致)
+    bool read(std::string& val)
+    {
+        char c = peek();
+        if(c == '"')
+        {
+            std::string_view str;
+            if(!parseString(str))
+                return false;
+            val.assign(str.data(), str.size());
+            return true;
+        }
+        if(c == 't' || c == 'f')
+        {
+            bool b;
+            if(!read(b))
+                return false;
+            val = b ? "true" : "false";
+            return true;
+        }
+        std::string_view num;
+        if(!scanNumber(num))
+            return false;
+        val.assign(num.data(), num.size());
+        return true;
+    }
+
+    // 数字也接受字符串形式("123")，ESInsert 写入的字段都是字符串
+    bool read(int64_t& val)
+    {
+        return readNumber(val);
+    }
+    bool read(int32_t& val)
+    {
+        return readNumber(val);
+    }
+    bool read(uint64_t& val)
+    {
+        return readNumber(val);
+    }
+    bool read(uint32_t& val)
+    {
+        return readNumber(val);
+    }
+    bool read(double& val)
+    {
+        return readNumber(val);
+    }
+
+    bool read(bool& val)
+    {
+        char c = peek();
+        if(c == 't' && literal("true"))
+            val = true;
+        else if(c == 'f' && literal("false"))
+            val = false;
+        else
+            return fail("expect boolean");
+        return true;
+    }
+
+    // 跳过当前值(包括嵌套的对象和数组)
+    bool skip()
+    {
+        char c = peek();
+        switch(c)
+        {
+        case '"':
+            return skipString();
+        case '{':
+        case '[':
+            return skipContainer();
+        case 't':
+            return literal("true");
+        case 'f':
+            return literal("false");
+        case 'n':
+            return literal("null");
+        default:
+        {
+            std::string_view num;
+            return scanNumber(num);
+        }
+        }
+    }
+private:
+    void skipSpace()
+    {
+        while(_pos < _end && (*_pos == ' ' || *_pos == '\n' || *_pos == '\r' || *_pos == '\t'))
+            ++_pos;
+    }
+
+    bool fail(const char* error)
+    {
+        if(_error == nullptr)
+            _error = error;
+        return false;
+    }
+
+    bool consume(char c, const char* error)
+    {
+        if(peek() != c)
+            return fail(error);
+        ++_pos;
+        return true;
+    }
+
+    bool literal(std::string_view word)
+    {
+        if((size_t)(_end - _pos) < word.size() || std::string_view(_pos, word.size()) != word)
+            return fail("invalid literal");
+        _pos += word.size();
+        return true;
+    }
+
+    // 对象/数组中读取下一项前的分隔符处理
+    bool nextItem(char close)
+    {
+        char c = peek();
+        if(c == close)
+        {
+            ++_pos;
+            return false;
+        }
+        if(c == ',')
+        {
+            ++_pos;
+            c = peek();
+        }
+        if(c == 0 || c == close)
+            return fail("unexpected end of container");
+        return true;
+    }
+
+    // 不含转义的字符串直接引用输入，否则解码到 _scratch
+    bool parseString(std::string_view& str)
+    {
+        if(!consume('"', "expect string"))
+            return false;
+        const char* start = _pos;
+        while(_pos < _end && *_pos != '"' && *_pos != '\\')
+            ++_pos;
+        if(_pos >= _end)
+            return fail("unterminated string");
+        if(*_pos == '"')
+        {
+            str = std::string_view(start, _pos - start);
+            ++_pos;
+            return true;
+        }
+        _scratch.assign(start, _pos - start);
+        while(_pos < _end && *_pos != '"')
+        {
+            if(*_pos != '\\')
+            {
+                _scratch.push_back(*_pos++);
+                continue;
+            }
+            if(++_pos >= _end)
+                break;
+            char c = *_pos++;
+            switch(c)
+            {
+            case '"': _scratch.push_back('"'); break;
+            case '\\': _scratch.push_back('\\'); break;
+            case '/': _scratch.push_back('/'); break;
+            case 'b': _scratch.push_back('\b'); break;
+            case 'f': _scratch.push_back('\f'); break;
+            case 'n': _scratch.push_back('\n'); break;
+            case 'r': _scratch.push_back('\r'); break;
+            case 't': _scratch.push_back('\t'); break;
+            case 'u':
+                if(!parseUnicode())
+                    return false;
+                break;
+            default:
+                return fail("invalid escape");
+            }
+        }
+        if(_pos >= _end)
+            return fail("unterminated string");
+        ++_pos;
+        str = _scratch;
+        return true;
+    }
+
+    bool parseHex4(uint32_t& cp)
+    {
+        if(_end - _pos < 4)
+            return fail("invalid \\u escape");
+        cp = 0;
+        for(int i = 0; i < 4; ++i)
+        {
+            char c = *_pos++;
+            cp <<= 4;
+            if(c >= '0' && c <= '9')
+                cp |= c - '0';
+            else if(c >= 'a' && c <= 'f')
+                cp |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F')
+                cp |= c - 'A' + 10;
+            else
+                return fail("invalid \\u escape");
+        }
+        return true;
+    }
+
+    // \uXXXX(含代理对)转为 UTF-8
+    bool parseUnicode()
+    {
+        uint32_t cp;
+        if(!parseHex4(cp))
+            return false;
+        if(cp >= 0xD800 && cp <= 0xDBFF)
+        {
+            uint32_t low;
+            if(_end - _pos < 2 || _pos[0] != '\\' || _pos[1] != 'u')
+                return fail("unpaired surrogate");
+            _pos += 2;
+            if(!parseHex4(low) || low < 0xDC00 || low > 0xDFFF)
+                return fail("unpaired surrogate");
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        if(cp < 0x80)
+            _scratch.push_back((char)cp);
+        else if(cp < 0x800)
+        {
+            _scratch.push_back((char)(0xC0 | (cp >> 6)));
+            _scratch.push_back((char)(0x80 | (cp & 0x3F)));
+        }
+        else if(cp < 0x10000)
+        {
+            _scratch.push_back((char)(0xE0 | (cp >> 12)));
+            _scratch.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+            _scratch.push_back((char)(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            _scratch.push_back((char)(0xF0 | (cp >> 18)));
+            _scratch.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+            _scratch.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+            _scratch.push_back((char)(0x80 | (cp & 0x3F)));
+        }
+        return true;
+    }
+
+    bool skipString()
+    {
+        ++_pos;
+        while(_pos < _end)
+        {
+            const char* quote = (const char*)memchr(_pos, '"', _end - _pos);
+            if(quote == nullptr)
+                break;
+            // 引号前连续反斜杠为奇数个时该引号被转义
+            const char* p = quote;
+            while(p > _pos && p[-1] == '\\')
+                --p;
+            _pos = quote + 1;
+            if(((quote - p) & 1) == 0)
+                return true;
+        }
+        return fail("unterminated string");
+    }
+
+    // 只匹配括号层数，字符串内容按 skipString 跳过
+    bool skipContainer()
+    {
+        int depth = 0;
+        while(_pos < _end)
+        {
+            char c = *_pos;
+            if(c == '"')
+            {
+                if(!skipString())
+                    return false;
+                continue;
+            }
+            ++_pos;
+            if(c == '{' || c == '[')
+                ++depth;
+            else if((c == '}' || c == ']') && --depth == 0)
+                return true;
+        }
+        return fail("unterminated container");
+    }
+
+    bool scanNumber(std::string_view& num)
+    {
+        skipSpace();
+        const char* start = _pos;
+        while(_pos < _end && ((*_pos >= '0' && *_pos <= '9') || *_pos == '-' || *_pos == '+' || *_pos == '.' || *_pos == 'e' || *_pos == 'E'))
+            ++_pos;
+        if(_pos == start)
+            return fail("expect value");
+        num = std::string_view(start, _pos - start);
+        return true;
+    }
+
+    template<typename T>
+    bool readNumber(T& val)
+    {
+        std::string_view num;
+        if(peek() == '"')
+        {
+            if(!parseString(num))
+                return false;
+        }
+        else if(!scanNumber(num))
+            return false;
+        auto [end, ec] = std::from_chars(num.data(), num.data() + num.size(), val);
+        if(ec != std::errc() || end != num.data() + num.size())
+            return fail("invalid number");
+        return true;
+    }
+
+private:
+    const char* _begin;
+    const char* _pos;
+    const char* _end;
+    const char* _error = nullptr;
+    std::string _scratch; // 含转义字符的字符串解码后的内容
+};
+
+// dst 会被清空后写入，调用方反复使用同一个 dst 时不再重新分配内存
+bool Serialize(const Json::Value& val, std::string& dst)
+{
+#ifdef HMY_JSON_FAST_WRITER
+    bool ret = JsonFastWriter::write(val, dst);
+#else
+    bool ret = JsonStreamCodec::write(val, dst);
+#endif
+    if(ret == false)
+    {
+        std::cout << "Json 序列化失败!\n";
+        return false;
+    }
+    return true;
+}
+
+bool UnSerialize(const char* data, size_t size, Json::Value& val)
+{
+    std::string err;
+    bool ret = JsonStreamCodec::read(data, data + size, val, err);
+    if(ret == false)
+    {
+        std::cout << "Json 反序列化失败: " << err << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool UnSerialize(const std::string& src, Json::Value& val)
+{
+    return UnSerialize(src.data(), src.size(), val);
+}
+}
@@ -3,12 +3,218 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/async.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/details/file_helper.h>
+#include <spdlog/details/periodic_worker.h>
+#include <zstd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <string>
+#include <cstring>
 #include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include "flight_recorder.hpp"
+#include "trace.hpp"
+#ifdef HMY_LOG_BINARY
+#include "binlog.hpp"
+#endif
 
 // mode 指运行模式， true--发布模式，false--调试模式
 namespace hmy{
 std::shared_ptr<spdlog::logger> g_default_logger;
+std::shared_ptr<spdlog::details::thread_pool> g_log_thread_pool; // 异步模式下的后台写日志线程池
+
+// 发布模式下的异步日志参数
+// 业务线程只把日志放入有界队列，格式化、写文件和刷盘都由后台线程完成
+struct AsyncLogOptions
+{
+    size_t queue_size = 8192; // 队列最多缓存的日志条数
+    bool drop_oldest = false; // 队列满时 false--阻塞等待，true--覆盖最旧的日志，丢弃条数通过 log_dropped 获取
+    int flush_interval = 3; // 定期刷盘的间隔(秒)，error 及以上级别的日志立即刷盘
+    int cpu = -1; // 后台线程绑定的 CPU 编号，-1 表示不绑定
+};
+
+// 发布模式下的日志文件切分参数，两者都不开启时不切分
+struct LogRotateOptions
+{
+    size_t max_size = 0; // 单个日志文件的大小上限(字节)，0 表示不按大小切分
+    bool hourly = false; // 是否在整点切分
+    int compress_level = 3; // 切分出的文件由后台线程压缩为 .zst 的 zstd 等级，0 表示不压缩
+};
+
+// 按大小/按小时切分的日志文件 sink
+// 切分时把当前文件原子地重命名为 "文件名.年月日-时分秒"，再重新打开原文件名继续写入，
+// 切分出的文件交给一个低优先级的后台线程压缩，写日志的线程不承担压缩开销
+class RotatingLogSink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+    RotatingLogSink(const std::string& file, const LogRotateOptions& options)
+    : _file(file), _options(options), _stop(false)
+    {
+        _file_helper.open(_file, false);
+        _size = _file_helper.size();
+        _hour = currentHour(spdlog::log_clock::now());
+        if(_options.compress_level > 0)
+            _compressor = std::thread(&RotatingLogSink::compressLoop, this);
+    }
+
+    ~RotatingLogSink()
+    {
+        {
+            std::unique_lock lock(_queue_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        if(_compressor.joinable())
+            _compressor.join();
+    }
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override
+    {
+        spdlog::memory_buf_t formatted;
+        formatter_->format(msg, formatted);
+        bool full = _options.max_size > 0 && _size > 0 && _size + formatted.size() > _options.max_size;
+        bool new_hour = _options.hourly && currentHour(msg.time) != _hour;
+        if((full || new_hour) && msg.time >= _retry_after)
+            rotate(msg.time);
+        _file_helper.write(formatted);
+        _size += formatted.size();
+    }
+
+    void flush_() override
+    {
+        _file_helper.flush();
+    }
+private:
+    static int64_t currentHour(spdlog::log_clock::time_point tp)
+    {
+        return std::chrono::duration_cast<std::chrono::hours>(tp.time_since_epoch()).count();
+    }
+
+    // 重命名失败时原文件保持不动，以追加方式重新打开继续写入，RETRY_INTERVAL 之后再尝试切分
+    void rotate(spdlog::log_clock::time_point tp)
+    {
+        _file_helper.close();
+        std::tm tm = spdlog::details::os::localtime(spdlog::log_clock::to_time_t(tp));
+        char suffix[32];
+        strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &tm);
+        std::string target = _file + suffix;
+        // 同一秒内多次切分时追加序号，避免覆盖
+        for(int i = 1; std::filesystem::exists(target) || std::filesystem::exists(target + ".zst"); ++i)
+            target = _file + suffix + "." + std::to_string(i);
+        if(std::rename(_file.c_str(), target.c_str()) != 0)
+        {
+            std::cerr << "日志文件切分失败: " << _file << " -> " << target << ": " << strerror(errno) << std::endl;
+            _file_helper.open(_file, false);
+            _retry_after = tp + RETRY_INTERVAL;
+            return;
+        }
+        if(_options.compress_level > 0)
+        {
+            std::unique_lock lock(_queue_mutex);
+            _pending.push_back(target);
+            _cond.notify_one();
+        }
+        _file_helper.open(_file, true);
+        _size = 0;
+        _hour = currentHour(tp);
+    }
+
+    void compressLoop()
+    {
+        // 仅降低本线程的调度优先级
+        setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+        while(true)
+        {
+            std::string path;
+            {
+                std::unique_lock lock(_queue_mutex);
+                _cond.wait(lock, [this](){ return _stop || !_pending.empty(); });
+                if(_pending.empty())
+                    return;
+                path = _pending.front();
+                _pending.pop_front();
+            }
+            compress(path);
+        }
+    }
+
+    // 先写入临时文件，完成后再重命名为 .zst 并删除原文件，中途失败不会留下不完整的 .zst
+    void compress(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::ofstream out(path + ".zst.tmp", std::ios::binary | std::ios::trunc);
+        ZSTD_CCtx* cctx = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, _options.compress_level);
+        std::string ibuf(ZSTD_CStreamInSize(), '\0');
+        std::string obuf(ZSTD_CStreamOutSize(), '\0');
+        bool ok = in.is_open() && out.is_open();
+        while(ok)
+        {
+            in.read(ibuf.data(), ibuf.size());
+            size_t n = in.gcount();
+            ZSTD_EndDirective mode = in.eof() ? ZSTD_e_end : ZSTD_e_continue;
+            ZSTD_inBuffer input = {ibuf.data(), n, 0};
+            bool finished = false;
+            while(!finished)
+            {
+                ZSTD_outBuffer output = {obuf.data(), obuf.size(), 0};
+                size_t remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+                if(ZSTD_isError(remaining))
+                {
+                    ok = false;
+                    break;
+                }
+                out.write(obuf.data(), output.pos);
+                finished = mode == ZSTD_e_end ? remaining == 0 : input.pos == input.size;
+            }
+            if(mode == ZSTD_e_end)
+                break;
+        }
+        ZSTD_freeCCtx(cctx);
+        out.close();
+        ok = ok && (bool)out;
+        std::error_code ec;
+        if(ok)
+        {
+            std::filesystem::rename(path + ".zst.tmp", path + ".zst", ec);
+            ok = !ec;
+        }
+        if(ok)
+            std::filesystem::remove(path, ec);
+        else
+        {
+            std::filesystem::remove(path + ".zst.tmp", ec);
+            std::cerr << "日志文件压缩失败: " << path << std::endl;
+        }
+    }
+
+private:
+    std::string _file;
+    LogRotateOptions _options;
+    spdlog::details::file_helper _file_helper;
+    static constexpr std::chrono::seconds RETRY_INTERVAL{60}; // 切分失败后再次尝试的间隔
+    size_t _size; // 当前文件已写入的字节数
+    int64_t _hour; // 当前文件所属的小时
+    spdlog::log_clock::time_point _retry_after; // 上次切分失败后，在此之前不再尝试
+
+    std::mutex _queue_mutex;
+    std::condition_variable _cond;
+    bool _stop;
+    std::deque<std::string> _pending; // 待压缩的文件
+    std::thread _compressor;
+};
+
 void init_logger(bool mode, const std::string& file, int32_t level)
 {
     if(mode == false)
@@ -16,7 +222,7 @@ void init_logger(bool mode, const std::string& file, int32_t level)
         // 如果是调试模式，则创建标准输出日志器，输出等级为最低
         g_default_logger = spdlog::stdout_color_mt("default-logger");
         g_default_logger->set_level(spdlog::level::level_enum::trace);
-        g_default_logger->flush_on(spdlog::level::level_enum::trace); 
+        g_default_logger->flush_on(spdlog::level::level_enum::trace);
     }
     else
     {
@@ -28,10 +234,293 @@ void init_logger(bool mode, const std::string& file, int32_t level)
     g_default_logger->set_pattern("[%n][%H:%M:%S][%t][%-8l]%v");
 }
 
-#define LOG_TRACE(format, ...)  g_default_logger->trace(std::string("[{}:{}]") + format, __FILE__, __LINE__, ##__VA_ARGS__)
-#define LOG_DEBUG(format, ...)  g_default_logger->debug(std::string("[{}:{}]") + format, __FILE__, __LINE__, ##__VA_ARGS__)
-#define LOG_INFO(format, ...)  g_default_logger->info(std::string("[{}:{}]") + format, __FILE__, __LINE__, ##__VA_ARGS__)
-#define LOG_WARN(format, ...)  g_default_logger->warn(std::string("[{}:{}]") + format, __FILE__, __LINE__, ##__VA_ARGS__)
-#define LOG_ERROR(format, ...)  g_default_logger->error(std::string("[{}:{}]") + format, __FILE__, __LINE__, ##__VA_ARGS__)
-#define LOG_FATAL(format, ...)  g_default_logger->critical(std::string("[{}:{}]") + format, __FILE__, __LINE__, ##__VA_ARGS__)
+// 发布模式下创建异步文件日志器，可按大小/按小时切分日志文件，调试模式与 init_logger(mode, file, level) 相同
+void init_logger(bool mode, const std::string& file, int32_t level, const AsyncLogOptions& options, const LogRotateOptions& rotate = LogRotateOptions())
+{
+    if(mode == false)
+    {
+        init_logger(mode, file, level);
+        return;
+    }
+    int cpu = options.cpu;
+    g_log_thread_pool = std::make_shared<spdlog::details::thread_pool>(options.queue_size, 1, [cpu](){
+        if(cpu < 0)
+            return;
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    });
+    spdlog::sink_ptr sink;
+    if(rotate.max_size > 0 || rotate.hourly)
+        sink = std::make_shared<RotatingLogSink>(file, rotate);
+    else
+        sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(file);
+    auto policy = options.drop_oldest ? spdlog::async_overflow_policy::overrun_oldest : spdlog::async_overflow_policy::block;
+    g_default_logger = std::make_shared<spdlog::async_logger>("default-logger", sink, g_log_thread_pool, policy);
+    g_default_logger->set_level((spdlog::level::level_enum)level);
+    g_default_logger->flush_on(spdlog::level::level_enum::err);
+    g_default_logger->set_pattern("[%n][%H:%M:%S][%t][%-8l]%v");
+    // 注册后才能被 flush_every 的定时刷盘覆盖
+    spdlog::register_logger(g_default_logger);
+    spdlog::flush_every(std::chrono::seconds(options.flush_interval));
+}
+
+FlightRecorder::ptr g_flight_recorder;
+// 开启飞行记录器：LOG_TRACE/LOG_DEBUG 不受日志等级限制地记入内存环形缓冲区，
+// 收到 SIGUSR2、进程崩溃或管理接口调用(FlightRecorder::mountDumpHandler)时转储到 dump_dir
+void init_flight_recorder(const std::string& dump_dir, size_t slots_per_thread = 1024)
+{
+    g_flight_recorder = std::make_shared<FlightRecorder>(dump_dir, slots_per_thread);
+    g_flight_recorder->setDumpCallback([](const std::string& path){
+        g_default_logger->warn("飞行记录已转储到 {}", path);
+        g_default_logger->flush();
+    });
+    g_flight_recorder->watchSignal(SIGUSR2);
+    g_flight_recorder->dumpOnCrash();
+}
+
+#ifdef HMY_LOG_BINARY
+BinLog::ptr g_binlog;
+// 开启二进制日志，日志文件需要用 binlog_decode 还原为文本
+void init_binlog(const std::string& file, int32_t level)
+{
+    g_binlog = std::make_shared<BinLog>(file, level);
+}
+#endif
+
+// 被抑制日志的定时汇报间隔(秒)
+#ifndef HMY_LOG_SUMMARY_INTERVAL
+#define HMY_LOG_SUMMARY_INTERVAL 10
+#endif
+
+// 单个日志调用点的令牌桶限流器，每秒补充 rate 个令牌，最多累积 burst 个
+// 令牌数(千分之一个为单位)与上次补充的时间(毫秒)打包在一个 64 位原子变量中，以 CAS 更新，热路径上不加锁
+// 所有限流器登记在全局列表中，后台定时器每隔 HMY_LOG_SUMMARY_INTERVAL 秒汇报一次尚未报告的抑制条数，
+// 突发之后再也没有输出的调用点同样能报告丢弃了多少条
+class LogRateLimiter
+{
+public:
+    LogRateLimiter(spdlog::level::level_enum level, const char* site, double rate, double burst)
+    : _level(level)
+    , _site(site)
+    , _rate(rate * SCALE / 1000)
+    , _burst((uint64_t)std::min(burst * SCALE, (double)TOKEN_MASK))
+    , _epoch(std::chrono::steady_clock::now())
+    , _state(_burst)
+    , _suppressed(0)
+    {
+        Registry& registry = getRegistry();
+        std::unique_lock lock(registry.mutex);
+        registry.limiters.push_back(this);
+        if(!registry.worker)
+            registry.worker = std::make_unique<spdlog::details::periodic_worker>(&LogRateLimiter::reportAll, std::chrono::seconds(HMY_LOG_SUMMARY_INTERVAL));
+    }
+
+    ~LogRateLimiter()
+    {
+        Registry& registry = getRegistry();
+        std::unique_lock lock(registry.mutex);
+        registry.limiters.erase(std::remove(registry.limiters.begin(), registry.limiters.end(), this), registry.limiters.end());
+    }
+
+    // 允许输出时返回 true，并通过 suppressed 返回自上次输出(或汇报)以来被抑制的条数
+    bool allow(uint64_t& suppressed)
+    {
+        uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _epoch).count();
+        uint64_t state = _state.load(std::memory_order_relaxed);
+        while(true)
+        {
+            uint64_t last = state >> TOKEN_BITS;
+            uint64_t tokens = state & TOKEN_MASK;
+            if(now > last)
+            {
+                double refilled = tokens + (now - last) * _rate;
+                tokens = refilled >= _burst ? _burst : (uint64_t)refilled;
+            }
+            // 令牌不足时不更新状态，之后的补充仍从上次取走令牌的时间算起
+            if(tokens < SCALE)
+            {
+                _suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            uint64_t next = (std::max(now, last) << TOKEN_BITS) | (tokens - SCALE);
+            if(_state.compare_exchange_weak(state, next, std::memory_order_relaxed))
+                break;
+        }
+        suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 立即汇报所有调用点尚未报告的抑制条数，由定时器调用，也可在进程退出前调用
+    static void reportAll()
+    {
+        Registry& registry = getRegistry();
+        std::unique_lock lock(registry.mutex);
+        for(LogRateLimiter* limiter : registry.limiters)
+        {
+            uint64_t suppressed = limiter->_suppressed.exchange(0, std::memory_order_relaxed);
+            if(suppressed > 0 && g_default_logger)
+                g_default_logger->log(limiter->_level, "{}已抑制 {} 条日志", limiter->_site, suppressed);
+        }
+    }
+private:
+    static constexpr uint64_t SCALE = 1000; // 一个令牌对应的计数
+    static constexpr int TOKEN_BITS = 24; // 低 24 位为令牌计数，高 40 位为毫秒时间戳
+    static constexpr uint64_t TOKEN_MASK = (1ull << TOKEN_BITS) - 1;
+
+    // worker 最后声明，析构时先停止定时器，回调不会访问已析构的成员
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<LogRateLimiter*> limiters;
+        std::unique_ptr<spdlog::details::periodic_worker> worker;
+    };
+    static Registry& getRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+private:
+    spdlog::level::level_enum _level;
+    const char* _site; // 调用点 "[文件:行号]"，汇报时输出
+    double _rate; // 每毫秒补充的令牌计数
+    uint64_t _burst; // 令牌计数的上限
+    std::chrono::steady_clock::time_point _epoch; // 时间戳的起点
+    std::atomic<uint64_t> _state;
+    std::atomic<uint64_t> _suppressed;
+};
+
+// 异步模式下因队列已满被覆盖丢弃的日志条数
+size_t log_dropped()
+{
+    return g_log_thread_pool ? g_log_thread_pool->overrun_counter() : 0;
+}
+
+// 编译期裁剪阈值(spdlog 等级数值)，低于该等级的日志宏展开为空，参数也不会求值
+#ifndef HMY_LOG_ACTIVE_LEVEL
+#define HMY_LOG_ACTIVE_LEVEL 0
+#endif
+
+#define HMY_LOG_STR_(x) #x
+#define HMY_LOG_STR(x) HMY_LOG_STR_(x)
+#define HMY_LOG_SITE "[" __FILE__ ":" HMY_LOG_STR(__LINE__) "]"
+// 存在追踪上下文时在内容前加上追踪 ID，作为格式串的第一个参数
+#define HMY_LOG_TRACE "[trace:{:016x}]"
+// 先判断等级再求值参数；"[文件:行号]" 前缀在编译期拼接到格式串中，格式串与参数在编译期校验
+#define HMY_TEXT_LOG(level, format, ...) do { \
+        if(g_default_logger->should_log(level)) { \
+            uint64_t hmy_trace_id = Trace::current().trace_id; \
+            if(hmy_trace_id != 0) \
+                g_default_logger->log(level, FMT_STRING(HMY_LOG_SITE HMY_LOG_TRACE format), hmy_trace_id, ##__VA_ARGS__); \
+            else \
+                g_default_logger->log(level, FMT_STRING(HMY_LOG_SITE format), ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+#ifdef HMY_LOG_BINARY
+// 二进制日志后端：init_binlog 之后 LOG_* 只记录调用点 ID 与原始参数，未初始化时仍走文本日志
+#define HMY_LOG(level, format, ...) do { \
+        if(!g_binlog) \
+            HMY_TEXT_LOG(level, format, ##__VA_ARGS__); \
+        else if(g_binlog->should_log(level)) { \
+            static std::atomic<uint32_t> hmy_log_site(0); \
+            static std::atomic<uint32_t> hmy_trace_site(0); \
+            if(false) \
+                (void)fmt::formatted_size(FMT_STRING(format), ##__VA_ARGS__); \
+            uint64_t hmy_trace_id = Trace::current().trace_id; \
+            if(hmy_trace_id != 0) \
+                g_binlog->write(hmy_trace_site, level, HMY_LOG_SITE HMY_LOG_TRACE format, hmy_trace_id, ##__VA_ARGS__); \
+            else \
+                g_binlog->write(hmy_log_site, level, HMY_LOG_SITE format, ##__VA_ARGS__); \
+        } \
+    } while(0)
+#else
+#define HMY_LOG(level, format, ...) HMY_TEXT_LOG(level, format, ##__VA_ARGS__)
+#endif
+
+// TRACE/DEBUG 在开启飞行记录器时总会记入内存缓冲区(编译期裁剪掉的等级除外)，同时按日志等级决定是否输出到日志
+// 开启时参数只求值一次，作为泛型 lambda 的参数(常量引用)同时交给两条路径；未开启时与 HMY_LOG 相同
+#define HMY_FLIGHT_LOG(level, format, ...) do { \
+        if(!g_flight_recorder) \
+            HMY_LOG(level, format, ##__VA_ARGS__); \
+        else \
+            [&](const auto&... hmy_args) { \
+                static std::atomic<uint32_t> hmy_flight_site(0); \
+                static std::atomic<uint32_t> hmy_flight_trace_site(0); \
+                uint64_t hmy_trace_id = Trace::current().trace_id; \
+                if(hmy_trace_id != 0) \
+                    g_flight_recorder->record(hmy_flight_trace_site, level, HMY_LOG_SITE HMY_LOG_TRACE format, hmy_trace_id, hmy_args...); \
+                else \
+                    g_flight_recorder->record(hmy_flight_site, level, HMY_LOG_SITE format, hmy_args...); \
+                HMY_LOG(level, format, hmy_args...); \
+            }(__VA_ARGS__); \
+    } while(0)
+
+#if HMY_LOG_ACTIVE_LEVEL <= 0
+#define LOG_TRACE(format, ...)  HMY_FLIGHT_LOG(spdlog::level::trace, format, ##__VA_ARGS__)
+#else
+#define LOG_TRACE(format, ...)  (void)0
+#endif
+#if HMY_LOG_ACTIVE_LEVEL <= 1
+#define LOG_DEBUG(format, ...)  HMY_FLIGHT_LOG(spdlog::level::debug, format, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...)  (void)0
+#endif
+#if HMY_LOG_ACTIVE_LEVEL <= 2
+#define LOG_INFO(format, ...)  HMY_LOG(spdlog::level::info, format, ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...)  (void)0
+#endif
+#if HMY_LOG_ACTIVE_LEVEL <= 3
+#define LOG_WARN(format, ...)  HMY_LOG(spdlog::level::warn, format, ##__VA_ARGS__)
+#else
+#define LOG_WARN(format, ...)  (void)0
+#endif
+#if HMY_LOG_ACTIVE_LEVEL <= 4
+#define LOG_ERROR(format, ...)  HMY_LOG(spdlog::level::err, format, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(format, ...)  (void)0
+#endif
+#if HMY_LOG_ACTIVE_LEVEL <= 5
+#define LOG_FATAL(format, ...)  HMY_LOG(spdlog::level::critical, format, ##__VA_ARGS__)
+#else
+#define LOG_FATAL(format, ...)  (void)0
+#endif
+
+// 限流版本，用于故障时可能被每个请求触发的日志，避免日志风暴拖垮磁盘
+// 每个调用点独立限流，每秒最多输出 HMY_LOG_RATE 条，允许 HMY_LOG_BURST 条突发，
+// 被抑制的条数在该调用点下一次输出前、或由定时汇报以一条汇总日志报告
+#ifndef HMY_LOG_RATE
+#define HMY_LOG_RATE 1
+#endif
+#ifndef HMY_LOG_BURST
+#define HMY_LOG_BURST 5
+#endif
+#define HMY_LOG_RL(level, format, ...) do { \
+        static hmy::LogRateLimiter hmy_log_limiter(level, HMY_LOG_SITE, HMY_LOG_RATE, HMY_LOG_BURST); \
+        uint64_t hmy_log_suppressed = 0; \
+        if(hmy_log_limiter.allow(hmy_log_suppressed)) { \
+            if(hmy_log_suppressed > 0) \
+                HMY_LOG(level, "已抑制 {} 条日志", hmy_log_suppressed); \
+            HMY_LOG(level, format, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+#if HMY_LOG_ACTIVE_LEVEL <= 2
+#define LOG_INFO_RL(format, ...)  HMY_LOG_RL(spdlog::level::info, format, ##__VA_ARGS__)
+#else
+#define LOG_INFO_RL(format, ...)  (void)0
+#endif
+#if HMY_LOG_ACTIVE_LEVEL <= 3
+#define LOG_WARN_RL(format, ...)  HMY_LOG_RL(spdlog::level::warn, format, ##__VA_ARGS__)
+#else
+#define LOG_WARN_RL(format, ...)  (void)0
+#endif
+#if HMY_LOG_ACTIVE_LEVEL <= 4
+#define LOG_ERROR_RL(format, ...)  HMY_LOG_RL(spdlog::level::err, format, ##__VA_ARGS__)
+#else
+#define LOG_ERROR_RL(format, ...)  (void)0
+#endif
 }
\ No newline at end of file
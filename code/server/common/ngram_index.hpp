@@ -0,0 +1,406 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+// 进程内 n-gram 倒排索引，用于在一个用户的好友范围内按昵称/用户ID/手机号搜索，不经过 ES
+// 文档的每个字段规范化(ASCII 转小写)后按 Unicode 字符切成一元和二元组，每个 n-gram 对应一个有序的文档编号列表(倒排表)；
+// 搜索范围(如某个用户的好友)也是一个有序的文档编号列表，查询时把范围和查询词各个二元组的倒排表求交集，
+// 再对候选文档做一次子串校验(校验是精确的，交集只用于缩小候选集)。交集在有 SSSE3 时(-mssse3 或 -march=native)每次比较 4x4 个编号，两个列表长度悬殊时改用跳跃查找
+// 文档和范围都可以增量更新，读多写少，使用读写锁
+namespace hmy{
+class NgramIndex
+{
+public:
+    using ptr = std::shared_ptr<NgramIndex>;
+
+    // 新增或替换文档，fields 为可搜索的字段
+    void upsert(const std::string& id, const std::vector<std::string>& fields)
+    {
+        std::vector<std::string> normalized;
+        for(const auto& field : fields)
+            normalized.push_back(normalize(field));
+        std::vector<uint64_t> grams = fieldGrams(normalized);
+
+        std::unique_lock lock(_mutex);
+        uint32_t doc = docOf(id);
+        Doc& d = _docs[doc];
+        // 新旧 n-gram 求差，只改动变化的倒排表
+        std::vector<uint64_t> removed, added;
+        std::set_difference(d.grams.begin(), d.grams.end(), grams.begin(), grams.end(), std::back_inserter(removed));
+        std::set_difference(grams.begin(), grams.end(), d.grams.begin(), d.grams.end(), std::back_inserter(added));
+        for(uint64_t gram : removed)
+            erasePosting(gram, doc);
+        for(uint64_t gram : added)
+            insertSorted(_postings[gram], doc);
+        // 字段之间用 '\0' 分隔，校验时一次查找覆盖所有字段且不会跨字段命中
+        d.text.clear();
+        for(const auto& field : normalized)
+            d.text.append(field).push_back('\0');
+        d.grams = std::move(grams);
+    }
+
+    void remove(const std::string& id)
+    {
+        std::unique_lock lock(_mutex);
+        auto it = _ids.find(id);
+        if(it == _ids.end())
+            return;
+        Doc& d = _docs[it->second];
+        for(uint64_t gram : d.grams)
+            erasePosting(gram, it->second);
+        // 编号仍可能被搜索范围引用，只清空内容；没有 n-gram 的文档不会出现在结果中
+        d.text.clear();
+        d.grams.clear();
+    }
+
+    // 搜索范围，如 scope 为用户ID、id 为其好友的用户ID；文档可以晚于范围关系加入
+    void addToScope(const std::string& scope, const std::string& id)
+    {
+        std::unique_lock lock(_mutex);
+        insertSorted(_scopes[scope], docOf(id));
+    }
+
+    void removeFromScope(const std::string& scope, const std::string& id)
+    {
+        std::unique_lock lock(_mutex);
+        auto sit = _scopes.find(scope);
+        auto it = _ids.find(id);
+        if(sit == _scopes.end() || it == _ids.end())
+            return;
+        eraseSorted(sit->second, it->second);
+        if(sit->second.empty())
+            _scopes.erase(sit);
+    }
+
+    void removeScope(const std::string& scope)
+    {
+        std::unique_lock lock(_mutex);
+        _scopes.erase(scope);
+    }
+
+    // 返回任一字段包含 query(不区分 ASCII 大小写)的文档ID，按加入顺序最多 limit 个；scope 为空时搜索全部文档
+    std::vector<std::string> search(const std::string& query, const std::string& scope = "", size_t limit = 20) const
+    {
+        std::vector<std::string> result;
+        std::string needle = normalize(query);
+        if(needle.empty() || limit == 0 || needle.find('\0') != std::string::npos)
+            return result;
+        std::vector<uint64_t> grams = queryGrams(needle);
+
+        std::shared_lock lock(_mutex);
+        const std::vector<uint32_t>* members = nullptr;
+        if(!scope.empty())
+        {
+            auto it = _scopes.find(scope);
+            if(it == _scopes.end())
+                return result;
+            members = &it->second;
+        }
+        std::vector<const std::vector<uint32_t>*> lists;
+        for(uint64_t gram : grams)
+        {
+            auto it = _postings.find(gram);
+            if(it == _postings.end())
+                return result;
+            lists.push_back(&it->second);
+        }
+        // 从最短的列表开始求交集，中间结果不会超过它
+        std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b){
+            return a->size() < b->size();
+        });
+        if(lists.empty() && !members)
+            return result;
+        const std::vector<uint32_t>* first = members && (lists.empty() || members->size() < lists[0]->size()) ? members : lists[0];
+        std::vector<uint32_t> candidates(first->begin(), first->end());
+        std::vector<uint32_t> buffer;
+        for(size_t i = 0; i < lists.size() && !candidates.empty(); ++i)
+        {
+            if(lists[i] == first)
+                continue;
+            // 剩下的倒排表都远长于候选集(如单字查询的一元组)，在其中逐个查找的访存比直接校验候选更多
+            if(lists[i]->size() > candidates.size() * VERIFY_RATIO)
+                break;
+            buffer.resize(candidates.size() + 4);
+            size_t n = intersect(candidates.data(), candidates.size(), lists[i]->data(), lists[i]->size(), buffer.data());
+            buffer.resize(n);
+            candidates.swap(buffer);
+        }
+        // 校验子串只能代替倒排表，范围必须求交集
+        if(members && members != first && !candidates.empty())
+        {
+            buffer.resize(candidates.size() + 4);
+            size_t n = intersect(candidates.data(), candidates.size(), members->data(), members->size(), buffer.data());
+            buffer.resize(n);
+            candidates.swap(buffer);
+        }
+        // 二元组都命中不代表连续出现，逐个校验子串
+        for(uint32_t doc : candidates)
+        {
+            const Doc& d = _docs[doc];
+            if(d.text.find(needle) != std::string::npos)
+                result.push_back(d.id);
+            if(result.size() >= limit)
+                break;
+        }
+        return result;
+    }
+
+    // 有内容的文档数
+    size_t size() const
+    {
+        std::shared_lock lock(_mutex);
+        size_t count = 0;
+        for(const auto& d : _docs)
+            count += !d.grams.empty();
+        return count;
+    }
+
+    // 两个严格递增列表的交集写入 out，out 至少能容纳 min(na, nb) + 4 个元素，返回交集大小
+    static size_t intersect(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        if(na > nb)
+        {
+            std::swap(a, b);
+            std::swap(na, nb);
+        }
+        if(na * GALLOP_RATIO < nb)
+            return intersectGallop(a, na, b, nb, out);
+#if defined(__SSSE3__)
+        return intersectSIMD(a, na, b, nb, out);
+#else
+        return intersectScalar(a, 0, na, b, 0, nb, out, 0);
+#endif
+    }
+private:
+    struct Doc
+    {
+        std::string id;
+        std::string text; // 规范化后的字段，以 '\0' 分隔
+        std::vector<uint64_t> grams; // 有序去重的 n-gram
+    };
+
+    // 编号只增不减，新文档总是追加在倒排表末尾
+    uint32_t docOf(const std::string& id)
+    {
+        auto it = _ids.find(id);
+        if(it != _ids.end())
+            return it->second;
+        uint32_t doc = (uint32_t)_docs.size();
+        _docs.push_back(Doc{id, {}, {}});
+        _ids.emplace(id, doc);
+        return doc;
+    }
+
+    void erasePosting(uint64_t gram, uint32_t doc)
+    {
+        auto it = _postings.find(gram);
+        if(it == _postings.end())
+            return;
+        eraseSorted(it->second, doc);
+        if(it->second.empty())
+            _postings.erase(it);
+    }
+
+    static void insertSorted(std::vector<uint32_t>& list, uint32_t doc)
+    {
+        if(list.empty() || list.back() < doc)
+        {
+            list.push_back(doc);
+            return;
+        }
+        auto it = std::lower_bound(list.begin(), list.end(), doc);
+        if(it == list.end() || *it != doc)
+            list.insert(it, doc);
+    }
+
+    static void eraseSorted(std::vector<uint32_t>& list, uint32_t doc)
+    {
+        auto it = std::lower_bound(list.begin(), list.end(), doc);
+        if(it != list.end() && *it == doc)
+            list.erase(it);
+    }
+
+    // ASCII 大写转小写，其余字节不变
+    static std::string normalize(const std::string& text)
+    {
+        std::string out(text);
+        for(char& c : out)
+        {
+            if(c >= 'A' && c <= 'Z')
+                c = c - 'A' + 'a';
+        }
+        return out;
+    }
+
+    // 按 UTF-8 解码为字符，非法字节按单字节处理
+    static std::vector<uint32_t> codepoints(const std::string& text)
+    {
+        std::vector<uint32_t> cps;
+        const unsigned char* p = (const unsigned char*)text.data();
+        const unsigned char* end = p + text.size();
+        while(p < end)
+        {
+            uint32_t cp = *p;
+            int len = cp < 0x80 ? 1 : (cp >> 5) == 0x6 ? 2 : (cp >> 4) == 0xE ? 3 : (cp >> 3) == 0x1E ? 4 : 1;
+            if(end - p < len)
+                len = 1;
+            if(len > 1)
+            {
+                cp &= 0xFF >> (len + 1);
+                for(int i = 1; i < len; ++i)
+                    cp = (cp << 6) | (p[i] & 0x3F);
+            }
+            cps.push_back(cp);
+            p += len;
+        }
+        return cps;
+    }
+
+    // 一元组: (1 << 42) | 字符；二元组: 前一字符 << 21 | 后一字符
+    static void appendGrams(const std::string& text, bool query, std::vector<uint64_t>& grams)
+    {
+        std::vector<uint32_t> cps = codepoints(text);
+        // 查询只有一个字符时用一元组，否则二元组已足够
+        if(!query || cps.size() == 1)
+        {
+            for(uint32_t cp : cps)
+                grams.push_back((1ULL << 42) | cp);
+        }
+        for(size_t i = 1; i < cps.size(); ++i)
+            grams.push_back(((uint64_t)cps[i - 1] << 21) | cps[i]);
+    }
+
+    static std::vector<uint64_t> fieldGrams(const std::vector<std::string>& fields)
+    {
+        std::vector<uint64_t> grams;
+        for(const auto& field : fields)
+            appendGrams(field, false, grams);
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        return grams;
+    }
+
+    static std::vector<uint64_t> queryGrams(const std::string& query)
+    {
+        std::vector<uint64_t> grams;
+        appendGrams(query, true, grams);
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        return grams;
+    }
+
+    static size_t intersectScalar(const uint32_t* a, size_t i, size_t na, const uint32_t* b, size_t j, size_t nb, uint32_t* out, size_t k)
+    {
+        while(i < na && j < nb)
+        {
+            if(a[i] < b[j])
+                ++i;
+            else if(a[i] > b[j])
+                ++j;
+            else
+            {
+                out[k++] = a[i];
+                ++i;
+                ++j;
+            }
+        }
+        return k;
+    }
+
+    // a 远短于 b 时，对 a 的每个元素在 b 中指数步长查找
+    static size_t intersectGallop(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        size_t k = 0, lo = 0;
+        for(size_t i = 0; i < na && lo < nb; ++i)
+        {
+            uint32_t target = a[i];
+            size_t step = 1, hi = lo;
+            while(hi < nb && b[hi] < target)
+            {
+                lo = hi + 1;
+                hi += step;
+                step <<= 1;
+            }
+            lo = std::lower_bound(b + lo, b + std::min(hi + 1, nb), target) - b;
+            if(lo < nb && b[lo] == target)
+                out[k++] = b[lo++];
+        }
+        return k;
+    }
+
+#if defined(__SSSE3__)
+    // 每次取两边各 4 个编号，与 b 的 4 种循环移位逐一比较，得到 a 中命中位置的掩码，再用查表得到的 pshufb 把命中的编号压紧写出
+    static size_t intersectSIMD(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out)
+    {
+        static const ShuffleTable table;
+        size_t i = 0, j = 0, k = 0;
+        size_t na4 = na & ~(size_t)3, nb4 = nb & ~(size_t)3;
+        while(i < na4 && j < nb4)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+            __m128i cmp = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+                _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+            if(mask)
+            {
+                _mm_storeu_si128((__m128i*)(out + k), _mm_shuffle_epi8(va, table.masks[mask]));
+                k += __builtin_popcount(mask);
+            }
+            uint32_t amax = a[i + 3], bmax = b[j + 3];
+            if(amax <= bmax)
+                i += 4;
+            if(bmax <= amax)
+                j += 4;
+        }
+        return intersectScalar(a, i, na, b, j, nb, out, k);
+    }
+
+    struct ShuffleTable
+    {
+        ShuffleTable()
+        {
+            for(int mask = 0; mask < 16; ++mask)
+            {
+                uint8_t bytes[16];
+                memset(bytes, 0x80, sizeof(bytes));
+                int n = 0;
+                for(int lane = 0; lane < 4; ++lane)
+                {
+                    if(mask & (1 << lane))
+                    {
+                        for(int b = 0; b < 4; ++b)
+                            bytes[n * 4 + b] = lane * 4 + b;
+                        ++n;
+                    }
+                }
+                masks[mask] = _mm_loadu_si128((const __m128i*)bytes);
+            }
+        }
+        __m128i masks[16];
+    };
+#endif
+
+private:
+    static constexpr size_t GALLOP_RATIO = 32; // 长列表超过短列表的该倍数时使用跳跃查找
+    static constexpr size_t VERIFY_RATIO = 32; // 倒排表超过候选集的该倍数时不再求交集，由子串校验过滤
+
+    mutable std::shared_mutex _mutex;
+    std::vector<Doc> _docs; // 下标为文档编号
+    std::unordered_map<std::string, uint32_t> _ids;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> _postings;
+    std::unordered_map<std::string, std::vector<uint32_t>> _scopes;
+};
+}
@@ -4,22 +4,425 @@
 #include <amqpcpp/libev.h>
 #include <openssl/ssl.h>
 #include <openssl/opensslv.h>
+#include <zstd.h>
 #include <iostream>
+#include <fstream>
+#include <filesystem>
 #include <functional>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <cstring>
+#include <unordered_map>
+#include <list>
+#include <map>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
 #include "logger.hpp"
 
 namespace hmy{
+// MQ 断连期间的本地落盘缓冲
+// 待发布的消息按顺序追加写入目录下的分段文件，重连后按写入顺序回放，回放完成的分段删除
+// 目录以锁文件独占，已被其他客户端(本进程或其他进程)占用时依次尝试 "目录.1"、"目录.2"...
+// 回放进度定期记录到目录下的 offset 文件，重启后从记录的位置继续
+class SpillBuffer
+{
+public:
+    // message_id 为空表示消息还未发布过，回放时再分配
+    // content_type 非空时回放的消息带上该类型(如已发布过的批量信封)
+    struct Record
+    {
+        std::string exchange;
+        std::string routing_key;
+        std::string body;
+        int flags;
+        std::string message_id;
+        std::string content_type;
+    };
+    using ReplayCallback = std::function<bool(const Record&)>;
+
+    SpillBuffer(const std::string& dir, size_t segment_size = 64 * 1024 * 1024)
+    : _segment_size(segment_size), _write_bytes(0), _read_offset(0), _replayed(0), _lock_fd(-1)
+    {
+        if(lockDirectory(dir) == false)
+            return;
+        std::error_code ec;
+        // 上次进程退出时遗留的分段同样需要回放
+        for(const auto& entry : std::filesystem::directory_iterator(_dir, ec))
+        {
+            if(entry.path().extension() != ".seg")
+                continue;
+            try
+            {
+                _segments.push_back(std::stoull(entry.path().stem().string()));
+            }
+            catch(const std::exception& e)
+            {
+                LOG_WARN("忽略无法识别的落盘分段: {}", entry.path().string());
+            }
+        }
+        std::sort(_segments.begin(), _segments.end());
+        if(!_segments.empty())
+        {
+            loadOffset();
+            LOG_INFO("发现 {} 个待回放的落盘分段", _segments.size());
+        }
+    }
+
+    ~SpillBuffer()
+    {
+        _writer.close();
+        if(_lock_fd >= 0)
+            ::close(_lock_fd);
+    }
+
+    const std::string& dir() const
+    {
+        return _dir;
+    }
+
+    bool empty() const
+    {
+        return _segments.empty();
+    }
+
+    // 追加一条消息，当前分段写满后切换到新分段
+    bool append(const std::string& exchange, const std::string& routing_key, const std::string& body, int flags,
+        const std::string& message_id = std::string(), const std::string& content_type = std::string())
+    {
+        size_t size = exchange.size() + routing_key.size() + body.size() + message_id.size() + content_type.size();
+        if(size > MAX_RECORD_SIZE)
+        {
+            LOG_ERROR("消息大小 {} 超过落盘记录上限 {}，无法落盘", size, MAX_RECORD_SIZE);
+            return false;
+        }
+        if(!_writer.is_open() || _write_bytes >= _segment_size)
+        {
+            if(openSegment() == false)
+                return false;
+        }
+        uint32_t header[6] = {(uint32_t)exchange.size(), (uint32_t)routing_key.size(), (uint32_t)body.size(), (uint32_t)flags,
+            (uint32_t)message_id.size(), (uint32_t)content_type.size()};
+        _writer.write((const char*)header, sizeof(header));
+        _writer.write(exchange.data(), exchange.size());
+        _writer.write(routing_key.data(), routing_key.size());
+        _writer.write(body.data(), body.size());
+        _writer.write(message_id.data(), message_id.size());
+        _writer.write(content_type.data(), content_type.size());
+        _writer.flush();
+        if(!_writer)
+        {
+            LOG_ERROR("写入落盘分段 {} 失败", segmentPath(_segments.back()));
+            _writer.close();
+            return false;
+        }
+        _write_bytes += sizeof(header) + size;
+        return true;
+    }
+
+    // 按写入顺序回放所有分段，cb 返回 false 时暂停(该条记录未回放)，下次从暂停的位置继续；全部回放完返回 true
+    bool replay(const ReplayCallback& cb)
+    {
+        size_t count = 0;
+        while(!_segments.empty())
+        {
+            // 正在写入的分段回放到末尾时才封口，之后的写入进入新分段；暂停不封口，不会产生大量小分段
+            bool writing = _segments.size() == 1 && _writer.is_open();
+            std::string path = segmentPath(_segments.front());
+            std::error_code ec;
+            uint64_t file_size = std::filesystem::file_size(path, ec);
+            if(ec)
+                file_size = 0;
+            std::ifstream reader(path, std::ios::binary);
+            reader.seekg(_read_offset);
+            Record record;
+            while(true)
+            {
+                if(readRecord(reader, file_size, record) == false)
+                {
+                    if(!writing)
+                        break;
+                    // 封口后再确认一次文件大小，cb 中(如断连时重新落盘)追加的记录也要读完
+                    _writer.close();
+                    _write_bytes = 0;
+                    writing = false;
+                    uint64_t size = std::filesystem::file_size(path, ec);
+                    if(ec || size <= file_size)
+                        break;
+                    file_size = size;
+                    reader.clear();
+                    reader.seekg(_read_offset);
+                    continue;
+                }
+                if(cb(record) == false)
+                {
+                    saveOffset();
+                    _replayed += count;
+                    return false;
+                }
+                _read_offset = reader.tellg();
+                if(++count % OFFSET_INTERVAL == 0)
+                    saveOffset();
+            }
+            reader.close();
+            std::filesystem::remove(path, ec);
+            _segments.pop_front();
+            _read_offset = 0;
+            saveOffset();
+        }
+        _replayed += count;
+        if(_replayed > 0)
+            LOG_INFO("落盘消息回放完成，共 {} 条", _replayed);
+        _replayed = 0;
+        return true;
+    }
+private:
+    static constexpr size_t OFFSET_INTERVAL = 256; // 每回放多少条记录一次进度，进程崩溃时最多重复回放这么多条
+    static constexpr int MAX_DIRECTORIES = 64; // 目录被占用时最多尝试的候选目录数
+    static constexpr size_t MAX_RECORD_SIZE = 128 * 1024 * 1024; // 单条记录的上限，与 RabbitMQ 默认的 max_message_size 相同
+
+    // 依次尝试 dir、dir.1、dir.2...，取第一个能独占锁文件的目录
+    bool lockDirectory(const std::string& dir)
+    {
+        for(int i = 0; i < MAX_DIRECTORIES; ++i)
+        {
+            std::string candidate = i == 0 ? dir : dir + "." + std::to_string(i);
+            std::error_code ec;
+            std::filesystem::create_directories(candidate, ec);
+            if(ec)
+            {
+                LOG_ERROR("创建落盘目录 {} 失败: {}", candidate, ec.message());
+                return false;
+            }
+            int fd = ::open((candidate + "/lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if(fd < 0)
+            {
+                LOG_ERROR("打开落盘目录锁文件 {}/lock 失败: {}", candidate, strerror(errno));
+                return false;
+            }
+            if(::flock(fd, LOCK_EX | LOCK_NB) == 0)
+            {
+                _dir = candidate;
+                _lock_fd = fd;
+                if(i > 0)
+                    LOG_INFO("落盘目录 {} 已被占用，改用 {}", dir, _dir);
+                return true;
+            }
+            ::close(fd);
+        }
+        LOG_ERROR("落盘目录 {} 及其 {} 个候选目录均被占用", dir, MAX_DIRECTORIES - 1);
+        return false;
+    }
+
+    // offset 文件内容为 "分段序号 偏移"，只对首个分段有效
+    void loadOffset()
+    {
+        std::ifstream reader(_dir + "/offset");
+        uint64_t seq;
+        long long offset;
+        if(reader >> seq >> offset && seq == _segments.front() && offset > 0)
+            _read_offset = offset;
+    }
+
+    // 先写临时文件再改名，进程崩溃时不会留下写了一半的进度
+    void saveOffset()
+    {
+        std::string path = _dir + "/offset";
+        std::error_code ec;
+        if(_segments.empty())
+        {
+            std::filesystem::remove(path, ec);
+            return;
+        }
+        {
+            std::ofstream writer(path + ".tmp", std::ios::trunc);
+            writer << _segments.front() << ' ' << (long long)_read_offset;
+            if(!writer)
+            {
+                LOG_ERROR_RL("记录落盘回放进度失败: {}", path);
+                return;
+            }
+        }
+        std::filesystem::rename(path + ".tmp", path, ec);
+        if(ec)
+            LOG_ERROR_RL("记录落盘回放进度失败: {}", ec.message());
+    }
+
+    std::string segmentPath(uint64_t seq) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%020lu.seg", (unsigned long)seq);
+        return _dir + "/" + name;
+    }
+
+    bool openSegment()
+    {
+        _writer.close();
+        if(_dir.empty())
+            return false; // 没有可用的落盘目录
+        uint64_t seq = _segments.empty() ? 0 : _segments.back() + 1;
+        _writer.open(segmentPath(seq), std::ios::binary | std::ios::app);
+        if(!_writer.is_open())
+        {
+            LOG_ERROR("打开落盘分段 {} 失败", segmentPath(seq));
+            return false;
+        }
+        _segments.push_back(seq);
+        _write_bytes = 0;
+        return true;
+    }
+
+    // 末尾不完整的记录（写入过程中进程崩溃）视为分段结束
+    // 长度字段损坏(超过记录上限或分段剩余大小)的记录同样视为分段结束，不按其长度分配内存
+    bool readRecord(std::ifstream& reader, uint64_t file_size, Record& record)
+    {
+        uint32_t header[6];
+        if(!reader.read((char*)header, sizeof(header)))
+            return false;
+        std::streamoff pos = reader.tellg();
+        uint64_t remain = pos >= 0 && (uint64_t)pos <= file_size ? file_size - pos : 0;
+        uint64_t size = (uint64_t)header[0] + header[1] + header[2] + header[4] + header[5];
+        if(size > MAX_RECORD_SIZE || size > remain)
+        {
+            LOG_WARN("落盘分段在偏移 {} 处的记录长度 {} 无效(剩余 {} 字节)，视为分段结束", (long long)pos - (long long)sizeof(header), size, remain);
+            return false;
+        }
+        record.exchange.resize(header[0]);
+        record.routing_key.resize(header[1]);
+        record.body.resize(header[2]);
+        record.flags = (int)header[3];
+        record.message_id.resize(header[4]);
+        record.content_type.resize(header[5]);
+        reader.read(record.exchange.data(), header[0]);
+        reader.read(record.routing_key.data(), header[1]);
+        reader.read(record.body.data(), header[2]);
+        reader.read(record.message_id.data(), header[4]);
+        reader.read(record.content_type.data(), header[5]);
+        return (bool)reader;
+    }
+
+private:
+    std::string _dir;
+    size_t _segment_size; // 单个分段文件的大小上限
+    size_t _write_bytes; // 当前写入分段已写入的字节数
+    std::streamoff _read_offset; // 首个分段已回放到的位置
+    size_t _replayed; // 本轮回放(可能分多次)已回放的记录数
+    std::deque<uint64_t> _segments; // 未回放的分段序号，按写入顺序排列
+    std::ofstream _writer;
+    int _lock_fd; // 落盘目录锁文件，持有期间其他客户端不会使用该目录
+};
+
+// 消费端去重过滤器：记录最近处理过的消息 ID，重复投递的消息在回调前丢弃
+// 只保存 ID 的 64 位哈希，按处理顺序淘汰，超出容量或时间窗口的记录被移除，内存占用有上限
+class DedupFilter
+{
+public:
+    DedupFilter(size_t capacity, double window)
+    : _capacity(capacity), _window(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(window)))
+    {}
+
+    bool contains(const std::string& id)
+    {
+        expire();
+        return _index.find(std::hash<std::string>()(id)) != _index.end();
+    }
+
+    void insert(const std::string& id)
+    {
+        size_t hash = std::hash<std::string>()(id);
+        if(_index.find(hash) != _index.end())
+            return;
+        _entries.push_back(std::make_pair(hash, std::chrono::steady_clock::now()));
+        _index.insert(std::make_pair(hash, std::prev(_entries.end())));
+        if(_entries.size() > _capacity)
+        {
+            _index.erase(_entries.front().first);
+            _entries.pop_front();
+        }
+    }
+private:
+    void expire()
+    {
+        auto deadline = std::chrono::steady_clock::now() - _window;
+        while(!_entries.empty() && _entries.front().second < deadline)
+        {
+            _index.erase(_entries.front().first);
+            _entries.pop_front();
+        }
+    }
+
+private:
+    using Entry = std::pair<size_t, std::chrono::steady_clock::time_point>;
+    size_t _capacity; // 最多记录的消息数量
+    std::chrono::steady_clock::duration _window; // 记录的保留时间
+    std::list<Entry> _entries; // 按插入顺序排列，队首最旧
+    std::unordered_map<size_t, std::list<Entry>::iterator> _index;
+};
+
+// 批量信封模式参数，任一阈值达到即发送
+struct MQBatchOptions
+{
+    size_t max_messages = 64; // 单个信封最多打包的消息条数
+    size_t max_bytes = 64 * 1024; // 单个信封打包前的最大字节数
+    double max_delay = 0.005; // 消息在信封中等待的最长时间(秒)
+    int compress_level = 1; // zstd 压缩等级，0 表示不压缩
+};
+
+// 消息通道(lane)：同一交换机下按消息大小分级路由到不同队列，消费端按权重在各队列间公平调度
+// 小的文本消息走高权重通道，不会被大体积的文件/语音通知阻塞
+struct MQLane
+{
+    std::string name; // 通道名，作为路由键，队列名为 "队列名.通道名"
+    size_t max_bytes; // 消息体不超过该大小时进入本通道，最后一个通道兜底
+    uint32_t weight; // 调度权重，每轮调度最多处理的消息条数
+    uint16_t prefetch; // 本通道消费者未确认消息的上限，0 表示不限制
+};
+
 class MQClient
 {
 public:
+    using ptr = std::shared_ptr<MQClient>;
     using MessageCallback = std::function<void(const char*, size_t)>;
-    MQClient(const std::string& user, const std::string& passwd, const std::string& host)
+    // spill_dir 为断连期间的落盘目录，已被其他客户端占用时改用 spill_dir.1、spill_dir.2...
+    MQClient(const std::string& user, const std::string& passwd, const std::string& host, const std::string& spill_dir = "./mq_spill")
     : _loop(EV_DEFAULT)
-    , _handler(_loop)
+    , _handler(_loop, this)
     , _address("amqp://" + user + ":" + passwd + "@" + host + "/")
-    , _connection(&_handler, _address)
-    , _channel(&_connection)
+    , _host(host)
+    , _running(true)
+    , _spill(spill_dir)
+    , _ready(false)
+    , _reconnecting(false)
+    , _backoff(MIN_BACKOFF)
+    , _replay_backoff(MIN_BACKOFF)
+    , _replay_timer_active(false)
+    , _batch_enabled(false)
+    , _batch_timer_active(false)
+    , _id_seq(0)
+    , _publish_seq(0)
+    , _lane_timer_active(false)
     {
+        std::random_device rd;
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "%08x%08x-", rd(), rd());
+        _id_prefix = prefix;
+        ev_async_init(&_async_watcher, async_callback);
+        _async_watcher.data = this;
+        ev_async_start(_loop, &_async_watcher);
+        ev_timer_init(&_reconnect_timer, reconnect_callback, 0, 0);
+        _reconnect_timer.data = this;
+        ev_timer_init(&_batch_timer, batch_callback, 0, 0);
+        _batch_timer.data = this;
+        ev_timer_init(&_lane_timer, lane_callback, 0, 0);
+        _lane_timer.data = this;
+        ev_timer_init(&_replay_timer, replay_callback, 0, 0);
+        _replay_timer.data = this;
+        connect();
         _loop_thread = std::thread([this](){
             ev_run(_loop, 0);
         });
@@ -27,81 +430,795 @@ public:
 
     ~MQClient()
     {
-        struct ev_async async_watcher;
-        ev_async_init(&async_watcher, watcher_callback);
-        ev_async_start(_loop, &async_watcher);
-        ev_async_send(_loop, &async_watcher);
+        {
+            std::unique_lock lock(_mutex);
+            _running = false;
+        }
+        ev_async_send(_loop, &_async_watcher);
         _loop_thread.join();
+        ev_timer_stop(_loop, &_reconnect_timer);
+        ev_timer_stop(_loop, &_batch_timer);
+        ev_timer_stop(_loop, &_lane_timer);
+        ev_timer_stop(_loop, &_replay_timer);
+        ev_async_stop(_loop, &_async_watcher);
         // ev_loop_destroy(_loop);
         _loop = nullptr;
     }
 
+    // 声明的交换机、队列及绑定关系会被记录下来，每次(重新)连接成功后重新声明
     void declareComponents(const std::string &exchange, const std::string &queue, const std::string &routing_key = "routing_key", AMQP::ExchangeType echange_type = AMQP::ExchangeType::direct)
     {
+        post([this, exchange, queue, routing_key, echange_type](){
+            _declarations.push_back(Declaration{exchange, queue, routing_key, echange_type});
+            if(_ready)
+                declare(_declarations.back());
+        });
+    }
+
+    // 消息交由事件循环线程发布，断连期间先落盘，重连后按顺序回放；已发出但服务器尚未确认的消息在断连时同样落盘
+    // 当前存在追踪上下文时随消息头传递，消费端在同一追踪中回调(落盘回放的消息不再携带)
+    // 返回 false 表示客户端已经停止，消息未被接收
+    bool publish(const std::string& exchange, const std::string& msg, const std::string& routing_key = "routing_key", int flags = 0)
+    {
+        std::string trace = traceHeader();
+        return post([this, exchange, msg, routing_key, flags, trace](){
+            doPublish(exchange, routing_key, msg, flags, trace);
+        });
+    }
+
+    // 开启消费端去重：按消息 ID 丢弃 window 秒内已处理过的重复投递(如信道重建后未确认消息的重投)
+    // 发布端会为每条消息(信封)生成唯一的消息 ID，已发出未确认的消息落盘回放时沿用原 ID
+    void enableDedup(size_t capacity = 100000, double window = 600)
+    {
+        post([this, capacity, window](){
+            _dedup = std::make_unique<DedupFilter>(capacity, window);
+        });
+    }
+
+    // 开启批量信封模式：同一交换机、路由键下的消息按发布顺序打包为一条 AMQP 消息并压缩
+    // 消费端无需开启，收到信封后会自动拆包，逐条调用 MessageCallback
+    void enableBatch(const MQBatchOptions& options = MQBatchOptions())
+    {
+        post([this, options](){
+            _batch_options = options;
+            _batch_enabled = true;
+        });
+    }
+
+    void consume(const std::string& queue, const std::string& tag, const MessageCallback& cb)
+    {
+        post([this, queue, tag, cb](){
+            _consumers.push_back(Consumer{queue, tag, cb, -1, 0, 0});
+            if(_ready)
+                subscribe(_consumers.back());
+        });
+    }
+
+    // 为每个通道声明队列 "queue.通道名" 并以通道名为路由键绑定到交换机，通道按 max_bytes 从小到大排列
+    void declareLanes(const std::string& exchange, const std::string& queue, const std::vector<MQLane>& lanes, AMQP::ExchangeType echange_type = AMQP::ExchangeType::direct)
+    {
+        for(const auto& lane : lanes)
+            declareComponents(exchange, queue + "." + lane.name, lane.name, echange_type);
+        post([this, exchange, lanes](){
+            _lanes[exchange] = lanes;
+        });
+    }
+
+    // 发布到 declareLanes 声明过的交换机，lane 为空时按消息大小选择通道
+    bool publishLane(const std::string& exchange, const std::string& msg, const std::string& lane = "", int flags = 0)
+    {
+        std::string trace = traceHeader();
+        return post([this, exchange, msg, lane, flags, trace](){
+            doPublish(exchange, chooseLane(exchange, msg, lane), msg, flags, trace);
+        });
+    }
+
+    // 订阅各通道队列，收到的消息按通道权重加权轮转调度后再调用 cb
+    void consumeLanes(const std::string& queue, const std::string& tag, const std::vector<MQLane>& lanes, const MessageCallback& cb)
+    {
+        post([this, queue, tag, lanes, cb](){
+            int group = _lane_groups.size();
+            _lane_groups.push_back(LaneGroup{lanes, std::vector<std::deque<Delivery>>(lanes.size()), std::vector<uint32_t>(lanes.size(), 0), cb});
+            for(size_t i = 0; i < lanes.size(); ++i)
+            {
+                _consumers.push_back(Consumer{queue + "." + lanes[i].name, tag + "." + lanes[i].name, cb, group, i, lanes[i].prefetch});
+                if(_ready)
+                    subscribe(_consumers.back());
+            }
+        });
+    }
+private:
+    struct Declaration
+    {
+        std::string exchange;
+        std::string queue;
+        std::string routing_key;
+        AMQP::ExchangeType type;
+    };
+    struct Consumer
+    {
+        std::string queue;
+        std::string tag;
+        MessageCallback cb;
+        int group; // 所属通道组下标，-1 表示普通消费者，收到消息直接回调
+        size_t lane; // 在通道组中的下标
+        uint16_t prefetch;
+    };
+    // 等待调度的一条投递，需要拷贝消息内容，确认要在同一信道上进行
+    struct Delivery
+    {
+        std::string body;
+        std::string content_type;
+        std::string content_encoding;
+        std::string message_id;
+        std::string trace;
+        uint64_t delivery_tag;
+        bool redelivered;
+    };
+    // consumeLanes 订阅的一组通道，deficit 为各通道本轮剩余可处理的条数
+    struct LaneGroup
+    {
+        std::vector<MQLane> lanes;
+        std::vector<std::deque<Delivery>> pending;
+        std::vector<uint32_t> deficit;
+        MessageCallback cb;
+    };
+    // 已发出但尚未被服务器确认(publisher confirm)的消息，断连或被服务器拒绝时连同消息 ID 重新落盘
+    // batched 为 true 时 frame 为批量信封打包前的内容，否则为消息体
+    struct Unconfirmed
+    {
+        std::string exchange;
+        std::string routing_key;
+        int flags;
+        bool batched;
+        std::string frame;
+        std::string message_id;
+    };
+    // 同一交换机、路由键下等待打包的消息，frame 中每条消息以 4 字节长度前缀顺序存放
+    // traces 为各条消息的追踪信息，以逗号分隔，与 frame 中的消息一一对应
+    struct Batch
+    {
+        std::string exchange;
+        std::string routing_key;
+        int flags;
+        size_t count;
+        std::string frame;
+        std::string traces;
+        bool traced;
+    };
+
+    // 将连接状态通知转交给 MQClient，所有回调都在事件循环线程中执行
+    class ConnectionHandler : public AMQP::LibEvHandler
+    {
+    public:
+        ConnectionHandler(struct ev_loop* loop, MQClient* client)
+        : AMQP::LibEvHandler(loop), _client(client)
+        {}
+        void onReady(AMQP::TcpConnection* connection) override
+        {
+            _client->onReady(connection);
+        }
+        void onError(AMQP::TcpConnection* connection, const char* message) override
+        {
+            _client->onLost(connection, message);
+        }
+        void onLost(AMQP::TcpConnection* connection) override
+        {
+            _client->onLost(connection, "连接丢失");
+        }
+        void onClosed(AMQP::TcpConnection* connection) override
+        {
+            _client->onLost(connection, "连接已关闭");
+        }
+    private:
+        MQClient* _client;
+    };
+
+    static constexpr double MIN_BACKOFF = 0.5; // 重连退避的初始间隔(秒)
+    static constexpr double MAX_BACKOFF = 30; // 重连退避的最大间隔(秒)
+    static constexpr size_t MAX_REPLAY_INFLIGHT = 256; // 回放时最多允许的未确认消息数，其余留在磁盘上，收到确认后继续回放
+    static constexpr const char* BATCH_CONTENT_TYPE = "application/x-hmy-batch"; // 批量信封的标识
+    static constexpr size_t MIN_COMPRESS_BYTES = 512; // 信封小于该大小时压缩收益不大，不压缩
+    static constexpr size_t MAX_BATCH_BYTES = 64 * 1024 * 1024; // 拆包时允许的最大解压后大小
+    static constexpr const char* TRACE_HEADER = "x-hmy-trace"; // 追踪信息 "追踪ID-spanID-发布时间(微秒)"，批量信封中以逗号分隔
+
+    bool post(const std::function<void()>& task)
+    {
+        {
+            std::unique_lock lock(_mutex);
+            if(_running == false)
+                return false;
+            _tasks.push_back(task);
+        }
+        ev_async_send(_loop, &_async_watcher);
+        return true;
+    }
+
+    void connect()
+    {
+        _channel.reset();
+        _connection.reset();
+        _connection = std::make_unique<AMQP::TcpConnection>(&_handler, _address);
+        _channel = std::make_unique<AMQP::TcpChannel>(_connection.get());
+        _channel->onError([this](const char* message){
+            // 信道出错后不可再用，关闭连接，由断连处理统一重建连接和信道
+            LOG_ERROR("MQ 信道异常: {}", message);
+            if(_connection)
+                _connection->close();
+        });
+    }
+
+    void onReady(AMQP::TcpConnection* connection)
+    {
+        if(connection != _connection.get())
+            return;
+        LOG_INFO("MQ 服务器 {} 连接成功", _host);
+        _ready = true;
+        _backoff = MIN_BACKOFF;
+        // 开启发布确认，服务器确认前的消息保留副本，断连时重新落盘，保证不丢消息
+        _publish_seq = 0;
+        _channel->confirmSelect()
+            .onAck([this](uint64_t tag, bool multiple){
+                confirm(tag, multiple, true);
+            })
+            .onNack([this](uint64_t tag, bool multiple, bool requeue){
+                confirm(tag, multiple, false);
+            });
+        for(const auto& declaration : _declarations)
+            declare(declaration);
+        for(const auto& consumer : _consumers)
+            subscribe(consumer);
+        replaySpill();
+    }
+
+    void onLost(AMQP::TcpConnection* connection, const char* message)
+    {
+        if(connection != _connection.get() || _reconnecting)
+            return;
+        LOG_ERROR("MQ 服务器 {} 连接断开: {}, {} 秒后重连", _host, message, _backoff);
+        _ready = false;
+        // 已发出未确认的消息可能没有到达服务器，按发布顺序落盘，之后是尚未发出的信封中的消息
+        spillUnconfirmed();
+        // 重连本身有退避，连接成功后直接回放
+        ev_timer_stop(_loop, &_replay_timer);
+        _replay_timer_active = false;
+        flushBatches();
+        // 未确认的投递会被服务器重新投递，旧信道上的投递标签已失效，直接丢弃
+        for(auto& group : _lane_groups)
+        {
+            for(auto& pending : group.pending)
+                pending.clear();
+        }
+        _reconnecting = true;
+        ev_timer_set(&_reconnect_timer, _backoff, 0);
+        ev_timer_start(_loop, &_reconnect_timer);
+        _backoff = std::min(_backoff * 2, MAX_BACKOFF);
+    }
+
+    void declare(const Declaration& declaration)
+    {
+        std::string exchange = declaration.exchange;
+        std::string queue = declaration.queue;
         // 声明交换机
-        AMQP::Deferred &exchange_deferred = _channel.declareExchange(exchange, echange_type);
-        exchange_deferred.onError([](const char *message){
-            LOG_ERROR("声明交换机失败: {}", message);
-            exit(0); 
+        AMQP::Deferred &exchange_deferred = _channel->declareExchange(exchange, declaration.type);
+        exchange_deferred.onError([exchange](const char *message){
+            LOG_ERROR("声明交换机 {} 失败: {}", exchange, message);
         });
-        exchange_deferred.onSuccess([exchange](){ 
+        exchange_deferred.onSuccess([exchange](){
             LOG_DEBUG("{} 交换机创建成功", exchange);
         });
         // 声明队列
-        AMQP::DeferredQueue &queue_deferred = _channel.declareQueue(queue);
-        queue_deferred.onError([](const char *message) {
-            LOG_ERROR("声明队列失败: {}", message);
-            exit(0); 
+        AMQP::DeferredQueue &queue_deferred = _channel->declareQueue(queue);
+        queue_deferred.onError([queue](const char *message) {
+            LOG_ERROR("声明队列 {} 失败: {}", queue, message);
         });
-        queue_deferred.onSuccess([queue](){ 
+        queue_deferred.onSuccess([queue](){
             LOG_DEBUG("{} 队列创建成功", queue);
         });
         // 针对交换机和队列进行绑定
-        AMQP::Deferred& binding_deferred = _channel.bindQueue(exchange, queue, routing_key);
+        AMQP::Deferred& binding_deferred = _channel->bindQueue(exchange, queue, declaration.routing_key);
         binding_deferred.onError([exchange, queue](const char* message){
             LOG_ERROR("{} --- {} 绑定失败: {}", exchange, queue, message);
-            exit(0);
         });
         binding_deferred.onSuccess([exchange, queue](){
             LOG_DEBUG("{} --- {} 绑定成功", exchange, queue);
         });
     }
 
-    bool publish(const std::string& exchange, const std::string& msg, const std::string& routing_key = "routing_key", int flags = 0)
+    void subscribe(const Consumer& consumer)
+    {
+        std::string queue = consumer.queue;
+        MessageCallback cb = consumer.cb;
+        int group = consumer.group;
+        size_t lane = consumer.lane;
+        // basic.qos 只对之后开始的消费者生效，订阅后恢复为不限制，不影响其他消费者
+        if(consumer.prefetch > 0)
+            _channel->setQos(consumer.prefetch);
+        AMQP::DeferredConsumer& consumer_deferred = _channel->consume(queue, consumer.tag);
+        if(consumer.prefetch > 0)
+            _channel->setQos(0);
+        consumer_deferred.onError([queue](const char* message){
+            LOG_ERROR("订阅 {} 队列消息失败: {}", queue, message);
+        });
+        consumer_deferred.onReceived([this, cb, group, lane](const AMQP::Message& message, uint64_t deliveryTag, bool redelivered){
+            std::string message_id = message.hasMessageID() ? message.messageID() : std::string();
+            std::string trace;
+            if(message.headers().contains(TRACE_HEADER))
+            {
+                const std::string& value = message.headers().get(TRACE_HEADER);
+                trace = value;
+            }
+            if(group < 0)
+            {
+                handleDelivery(message.body(), message.bodySize(), message.contentType(), message.contentEncoding(), message_id, trace, deliveryTag, redelivered, cb);
+                return;
+            }
+            _lane_groups[group].pending[lane].push_back(Delivery{std::string(message.body(), message.bodySize()),
+                message.contentType(), message.contentEncoding(), message_id, trace, deliveryTag, redelivered});
+            if(!_lane_timer_active)
+            {
+                // 延后到本轮网络读取处理完之后再调度，使同一批到达的消息能按权重排序
+                ev_timer_set(&_lane_timer, 0, 0);
+                ev_timer_start(_loop, &_lane_timer);
+                _lane_timer_active = true;
+            }
+        });
+    }
+
+    // 处理一条投递：去重、拆包、回调，最后确认
+    void handleDelivery(const char* body, size_t size, const std::string& content_type, const std::string& content_encoding,
+        const std::string& message_id, const std::string& trace, uint64_t delivery_tag, bool redelivered, const MessageCallback& cb)
     {
-        bool ret = _channel.publish(exchange, routing_key, msg, flags);
-        if(ret == false)
+        bool dedup = _dedup && !message_id.empty();
+        if(dedup && _dedup->contains(message_id))
         {
-            LOG_ERROR("{} 发布消息失败: {}", exchange);
+            LOG_DEBUG("丢弃重复投递的消息: {}, redelivered: {}", message_id, redelivered);
+            _channel->ack(delivery_tag);
+            return;
+        }
+        if(content_type == BATCH_CONTENT_TYPE)
+            unpackBatch(body, size, content_encoding, trace, cb);
+        else
+            deliver(cb, body, size, trace);
+        if(dedup)
+            _dedup->insert(message_id);
+        _channel->ack(delivery_tag);
+    }
+
+    // 加权差额轮转：每轮每个通道最多处理 weight 条，一轮结束后若仍有积压，让出事件循环后继续下一轮
+    // 这样新到达的小消息只需等待一轮，而不必排在全部大消息之后
+    void dispatchLanes()
+    {
+        bool backlog = false;
+        for(auto& group : _lane_groups)
+        {
+            for(size_t i = 0; i < group.lanes.size(); ++i)
+            {
+                auto& pending = group.pending[i];
+                group.deficit[i] += group.lanes[i].weight;
+                while(group.deficit[i] > 0 && !pending.empty())
+                {
+                    Delivery delivery = std::move(pending.front());
+                    pending.pop_front();
+                    --group.deficit[i];
+                    handleDelivery(delivery.body.data(), delivery.body.size(), delivery.content_type, delivery.content_encoding,
+                        delivery.message_id, delivery.trace, delivery.delivery_tag, delivery.redelivered, group.cb);
+                }
+                if(pending.empty())
+                    group.deficit[i] = 0;
+                else
+                    backlog = true;
+            }
+        }
+        if(backlog)
+        {
+            ev_timer_set(&_lane_timer, 0, 0);
+            ev_timer_start(_loop, &_lane_timer);
+            _lane_timer_active = true;
+        }
+    }
+
+    std::string chooseLane(const std::string& exchange, const std::string& msg, const std::string& lane)
+    {
+        if(!lane.empty())
+            return lane;
+        auto it = _lanes.find(exchange);
+        if(it == _lanes.end() || it->second.empty())
+        {
+            LOG_WARN_RL("{} 交换机未声明消息通道，使用默认路由键", exchange);
+            return "routing_key";
+        }
+        for(const auto& candidate : it->second)
+        {
+            if(msg.size() <= candidate.max_bytes)
+                return candidate.name;
+        }
+        return it->second.back().name;
+    }
+
+    // 当前追踪上下文对应的消息头，没有时为空串
+    static std::string traceHeader()
+    {
+        const TraceContext& ctx = Trace::current();
+        if(ctx.trace_id == 0)
+            return std::string();
+        return fmt::format("{:016x}-{:016x}-{}", ctx.trace_id, ctx.span_id, Trace::nowUs());
+    }
+
+    static bool parseTrace(std::string_view trace, TraceContext& ctx, int64_t& published)
+    {
+        size_t first = trace.find('-');
+        size_t second = first == std::string_view::npos ? first : trace.find('-', first + 1);
+        if(second == std::string_view::npos)
             return false;
+        ctx.trace_id = Trace::fromHex(trace.substr(0, first));
+        ctx.span_id = Trace::fromHex(trace.substr(first + 1, second - first - 1));
+        published = std::strtoll(std::string(trace.substr(second + 1)).c_str(), nullptr, 10);
+        return ctx.trace_id != 0;
+    }
+
+    // 带追踪信息的消息在追踪作用域中回调，被采样时另外记录一个从发布到开始消费的 span("mq.transit")
+    static void deliver(const MessageCallback& cb, const char* body, size_t size, std::string_view trace)
+    {
+        TraceContext upstream;
+        int64_t published;
+        if(trace.empty() || !parseTrace(trace, upstream, published))
+        {
+            cb(body, size);
+            return;
+        }
+        if(g_trace_exporter && g_trace_exporter->sampled(upstream.trace_id))
+            g_trace_exporter->record(upstream.trace_id, Trace::newId(), upstream.span_id, "mq.transit", published, Trace::nowUs() - published);
+        TraceScope scope("mq.consume", upstream.trace_id, upstream.span_id);
+        cb(body, size);
+    }
+
+    void doPublish(const std::string& exchange, const std::string& routing_key, const std::string& msg, int flags, const std::string& trace)
+    {
+        // 仍有未回放的落盘消息时，新消息继续落盘，保证整体顺序
+        if(_ready && !_spill.empty())
+            replaySpill();
+        if(_ready && _spill.empty() && _batch_enabled)
+        {
+            appendBatch(exchange, routing_key, msg, flags, trace);
+            return;
+        }
+        if(_ready && _spill.empty())
+        {
+            AMQP::Envelope envelope(msg.data(), msg.size());
+            setTrace(envelope, trace);
+            if(publishEnvelope(exchange, routing_key, envelope, flags, msg, false))
+                return;
+            LOG_ERROR_RL("{} 发布消息失败，转为落盘", exchange);
         }
+        if(_spill.append(exchange, routing_key, msg, flags) == false)
+            LOG_ERROR_RL("{} 消息落盘失败，消息丢失", exchange);
+    }
+
+    // 为消息分配唯一 ID 后发布，ID 由本客户端的随机前缀和递增序号组成；回放已发布过的消息时沿用原 ID，消费端据此去重
+    // 发布成功的消息连同 frame 记录到未确认列表，投递标签与信道上的发布顺序一致
+    bool publishEnvelope(const std::string& exchange, const std::string& routing_key, AMQP::Envelope& envelope, int flags,
+        const std::string& frame, bool batched, const std::string& message_id = std::string())
+    {
+        std::string id = message_id.empty() ? _id_prefix + std::to_string(_id_seq++) : message_id;
+        envelope.setMessageID(id);
+        if(!_channel->publish(exchange, routing_key, envelope, flags))
+            return false;
+        _unconfirmed.emplace(++_publish_seq, Unconfirmed{exchange, routing_key, flags, batched, frame, std::move(id)});
         return true;
     }
 
-    void consume(const std::string& queue, const std::string& tag, const MessageCallback& cb)
+    // 服务器确认(ack)的消息丢弃副本，并继续回放落盘消息；拒绝(nack)的重新落盘，退避一段时间后再回放，
+    // 避免服务器持续拒绝的消息(如队列溢出策略为 reject-publish)在发布-拒绝-落盘-回放之间空转
+    void confirm(uint64_t tag, bool multiple, bool ack)
     {
-        AMQP::DeferredConsumer& consumer_deferred = _channel.consume(queue, tag);
-        consumer_deferred.onError([queue](const char* message){
-            LOG_ERROR("订阅 {} 队列消息失败: {}", queue, message);
-            exit(0);
-        });
-        consumer_deferred.onReceived([this, cb](const AMQP::Message& message, uint64_t deliveryTag, bool redelivered){
-            cb(message.body(), message.bodySize());
-            _channel.ack(deliveryTag);
+        auto begin = _unconfirmed.begin();
+        auto end = _unconfirmed.upper_bound(tag);
+        if(!multiple)
+        {
+            begin = _unconfirmed.find(tag);
+            if(begin == _unconfirmed.end())
+                return;
+            end = std::next(begin);
+        }
+        if(ack)
+        {
+            _unconfirmed.erase(begin, end);
+            // 落盘消息全部回放且都已确认，退避恢复初始值
+            if(_spill.empty() && _unconfirmed.empty())
+                _replay_backoff = MIN_BACKOFF;
+            else if(!_spill.empty())
+                replaySpill();
+            return;
+        }
+        LOG_ERROR_RL("MQ 服务器拒绝了 {} 条消息，转为落盘，{} 秒后回放", std::distance(begin, end), _replay_backoff);
+        for(auto it = begin; it != end; ++it)
+            spill(it->second);
+        _unconfirmed.erase(begin, end);
+        if(_replay_timer_active)
+            return;
+        ev_timer_set(&_replay_timer, _replay_backoff, 0);
+        ev_timer_start(_loop, &_replay_timer);
+        _replay_timer_active = true;
+        _replay_backoff = std::min(_replay_backoff * 2, MAX_BACKOFF);
+    }
+
+    void spillUnconfirmed()
+    {
+        for(const auto& it : _unconfirmed)
+            spill(it.second);
+        _unconfirmed.clear();
+    }
+
+    // 已发布过的信封整体落盘并保留消息 ID，服务器其实已收到时，回放的副本会被消费端去重
+    void spill(const Unconfirmed& message)
+    {
+        const std::string content_type = message.batched ? BATCH_CONTENT_TYPE : std::string();
+        if(_spill.append(message.exchange, message.routing_key, message.frame, message.flags, message.message_id, content_type) == false)
+            LOG_ERROR_RL("{} 消息落盘失败，消息丢失", message.exchange);
+    }
+
+    // 拆开尚未发布的批量信封逐条落盘，回放时按普通消息发布
+    void spillFrame(const std::string& exchange, const std::string& routing_key, const std::string& frame, int flags)
+    {
+        size_t offset = 0;
+        while(offset < frame.size())
+        {
+            uint32_t len;
+            memcpy(&len, frame.data() + offset, sizeof(len));
+            offset += sizeof(len);
+            if(_spill.append(exchange, routing_key, frame.substr(offset, len), flags) == false)
+                LOG_ERROR_RL("{} 消息落盘失败，消息丢失", exchange);
+            offset += len;
+        }
+    }
+
+    static void setTrace(AMQP::Envelope& envelope, const std::string& trace)
+    {
+        if(trace.empty())
+            return;
+        AMQP::Table headers;
+        headers.set(TRACE_HEADER, trace);
+        envelope.setHeaders(headers);
+    }
+
+    void appendBatch(const std::string& exchange, const std::string& routing_key, const std::string& msg, int flags, const std::string& trace)
+    {
+        std::string key = exchange + '\0' + routing_key + '\0' + std::to_string(flags);
+        auto it = _batches.find(key);
+        if(it == _batches.end())
+            it = _batches.emplace(key, Batch{exchange, routing_key, flags, 0, std::string(), std::string(), false}).first;
+        Batch& batch = it->second;
+        uint32_t len = msg.size();
+        batch.frame.append((const char*)&len, sizeof(len));
+        batch.frame.append(msg);
+        if(batch.count > 0)
+            batch.traces += ',';
+        batch.traces += trace;
+        batch.traced = batch.traced || !trace.empty();
+        ++batch.count;
+        if(batch.count >= _batch_options.max_messages || batch.frame.size() >= _batch_options.max_bytes)
+        {
+            flushBatch(batch);
+            return;
+        }
+        if(!_batch_timer_active)
+        {
+            ev_timer_set(&_batch_timer, _batch_options.max_delay, 0);
+            ev_timer_start(_loop, &_batch_timer);
+            _batch_timer_active = true;
+        }
+    }
+
+    void flushBatches()
+    {
+        for(auto& it : _batches)
+            flushBatch(it.second);
+    }
+
+    void flushBatch(Batch& batch)
+    {
+        if(batch.count == 0)
+            return;
+        if(_ready)
+        {
+            if(publishBatch(batch))
+            {
+                batch.count = 0;
+                batch.frame.clear();
+                batch.traces.clear();
+                batch.traced = false;
+                return;
+            }
+            LOG_ERROR_RL("{} 发布批量消息失败，转为落盘", batch.exchange);
+        }
+        // 发布失败或已断连，拆开逐条落盘
+        spillFrame(batch.exchange, batch.routing_key, batch.frame, batch.flags);
+        batch.count = 0;
+        batch.frame.clear();
+        batch.traces.clear();
+        batch.traced = false;
+    }
+
+    bool publishBatch(const Batch& batch)
+    {
+        // 只有一条消息时不必包装为信封
+        if(batch.count == 1)
+        {
+            AMQP::Envelope envelope(batch.frame.data() + sizeof(uint32_t), batch.frame.size() - sizeof(uint32_t));
+            setTrace(envelope, batch.traces);
+            return publishEnvelope(batch.exchange, batch.routing_key, envelope, batch.flags, batch.frame, true);
+        }
+        std::string compressed;
+        if(_batch_options.compress_level > 0 && batch.frame.size() >= MIN_COMPRESS_BYTES)
+        {
+            compressed.resize(ZSTD_compressBound(batch.frame.size()));
+            size_t ret = ZSTD_compress(compressed.data(), compressed.size(), batch.frame.data(), batch.frame.size(), _batch_options.compress_level);
+            if(ZSTD_isError(ret) || ret >= batch.frame.size())
+                compressed.clear();
+            else
+                compressed.resize(ret);
+        }
+        const std::string& body = compressed.empty() ? batch.frame : compressed;
+        AMQP::Envelope envelope(body.data(), body.size());
+        envelope.setContentType(BATCH_CONTENT_TYPE);
+        if(!compressed.empty())
+            envelope.setContentEncoding("zstd");
+        if(batch.traced)
+            setTrace(envelope, batch.traces);
+        return publishEnvelope(batch.exchange, batch.routing_key, envelope, batch.flags, batch.frame, true);
+    }
+
+    static void unpackBatch(const char* data, size_t size, const std::string& content_encoding, std::string_view traces, const MessageCallback& cb)
+    {
+        std::string plain;
+        if(content_encoding == "zstd")
+        {
+            unsigned long long raw_size = ZSTD_getFrameContentSize(data, size);
+            if(raw_size == ZSTD_CONTENTSIZE_ERROR || raw_size == ZSTD_CONTENTSIZE_UNKNOWN || raw_size > MAX_BATCH_BYTES)
+            {
+                LOG_ERROR("批量消息解压失败: 无效的数据长度");
+                return;
+            }
+            plain.resize(raw_size);
+            size_t ret = ZSTD_decompress(plain.data(), plain.size(), data, size);
+            if(ZSTD_isError(ret))
+            {
+                LOG_ERROR("批量消息解压失败: {}", ZSTD_getErrorName(ret));
+                return;
+            }
+            data = plain.data();
+            size = ret;
+        }
+        else if(!content_encoding.empty())
+        {
+            LOG_ERROR("不支持的批量消息编码: {}", content_encoding);
+            return;
+        }
+        size_t offset = 0;
+        while(offset + sizeof(uint32_t) <= size)
+        {
+            uint32_t len;
+            memcpy(&len, data + offset, sizeof(len));
+            offset += sizeof(len);
+            if(len > size - offset)
+            {
+                LOG_ERROR("批量消息格式错误，丢弃剩余 {} 字节", size - offset);
+                return;
+            }
+            size_t comma = traces.find(',');
+            deliver(cb, data + offset, len, traces.substr(0, comma));
+            traces = comma == std::string_view::npos ? std::string_view() : traces.substr(comma + 1);
+            offset += len;
+        }
+    }
+
+    // 每次最多回放到未确认消息达到 MAX_REPLAY_INFLIGHT 条，积压的其余部分留在磁盘上，由确认回调继续，
+    // 不会一次性进入 AMQP-CPP 的发送缓冲区，也不会长时间占用事件循环；退避等待期间不回放
+    void replaySpill()
+    {
+        if(_replay_timer_active)
+            return;
+        _spill.replay([this](const SpillBuffer::Record& record){
+            if(_ready == false || _unconfirmed.size() >= MAX_REPLAY_INFLIGHT)
+                return false;
+            AMQP::Envelope envelope(record.body.data(), record.body.size());
+            bool batched = record.content_type == BATCH_CONTENT_TYPE;
+            if(batched)
+                envelope.setContentType(BATCH_CONTENT_TYPE);
+            return publishEnvelope(record.exchange, record.routing_key, envelope, record.flags, record.body, batched, record.message_id);
         });
     }
-private:
-    static void watcher_callback(struct ev_loop* loop, ev_async* watcher, int32_t revents)
+
+    static void async_callback(struct ev_loop* loop, ev_async* watcher, int32_t revents)
     {
-        ev_break(loop, EVBREAK_ALL);
+        MQClient* client = static_cast<MQClient*>(watcher->data);
+        std::deque<std::function<void()>> tasks;
+        bool running;
+        {
+            std::unique_lock lock(client->_mutex);
+            tasks.swap(client->_tasks);
+            running = client->_running;
+        }
+        for(auto& task : tasks)
+            task();
+        if(running == false)
+        {
+            // 退出时还没等到确认的消息同样落盘，下次启动时回放，重复的由消费端去重
+            client->flushBatches();
+            client->spillUnconfirmed();
+            ev_break(loop, EVBREAK_ALL);
+        }
+    }
+
+    static void lane_callback(struct ev_loop* loop, ev_timer* watcher, int32_t revents)
+    {
+        MQClient* client = static_cast<MQClient*>(watcher->data);
+        client->_lane_timer_active = false;
+        client->dispatchLanes();
+    }
+
+    static void batch_callback(struct ev_loop* loop, ev_timer* watcher, int32_t revents)
+    {
+        MQClient* client = static_cast<MQClient*>(watcher->data);
+        client->_batch_timer_active = false;
+        client->flushBatches();
+    }
+
+    static void replay_callback(struct ev_loop* loop, ev_timer* watcher, int32_t revents)
+    {
+        MQClient* client = static_cast<MQClient*>(watcher->data);
+        client->_replay_timer_active = false;
+        if(client->_ready)
+            client->replaySpill();
+    }
+
+    static void reconnect_callback(struct ev_loop* loop, ev_timer* watcher, int32_t revents)
+    {
+        MQClient* client = static_cast<MQClient*>(watcher->data);
+        client->_reconnecting = false;
+        LOG_INFO("正在重连 MQ 服务器 {}", client->_host);
+        client->connect();
     }
 
 private:
     struct ev_loop* _loop;
-    AMQP::LibEvHandler _handler;
+    ConnectionHandler _handler;
     AMQP::Address _address;
-    AMQP::TcpConnection _connection;
-    AMQP::TcpChannel _channel;
+    std::string _host; // 仅用于日志输出，避免打印带密码的地址
+    std::unique_ptr<AMQP::TcpConnection> _connection;
+    std::unique_ptr<AMQP::TcpChannel> _channel;
+    ev_async _async_watcher;
+    ev_timer _reconnect_timer;
+    ev_timer _batch_timer;
+    ev_timer _lane_timer;
+    ev_timer _replay_timer; // 消息被服务器拒绝后延迟回放
     std::thread _loop_thread;
+
+    std::mutex _mutex;
+    bool _running;
+    std::deque<std::function<void()>> _tasks; // 待事件循环线程执行的操作
+
+    // 以下成员只在事件循环线程中访问
+    SpillBuffer _spill;
+    bool _ready;
+    bool _reconnecting;
+    double _backoff;
+    double _replay_backoff; // 被拒绝的消息回放前的等待时间，连续被拒绝时加倍
+    bool _replay_timer_active;
+    std::vector<Declaration> _declarations;
+    std::vector<Consumer> _consumers;
+    bool _batch_enabled;
+    bool _batch_timer_active;
+    MQBatchOptions _batch_options;
+    std::unordered_map<std::string, Batch> _batches; // 交换机+路由键+标志 -> 待打包的消息
+    std::unique_ptr<DedupFilter> _dedup;
+    std::string _id_prefix;
+    uint64_t _id_seq;
+    uint64_t _publish_seq; // 当前信道上已发布的消息数，即最近一条消息的投递标签
+    std::map<uint64_t, Unconfirmed> _unconfirmed; // 投递标签 -> 等待服务器确认的消息
+    std::unordered_map<std::string, std::vector<MQLane>> _lanes; // 交换机 -> 发布端的通道划分
+    std::vector<LaneGroup> _lane_groups;
+    bool _lane_timer_active;
 };
 }
\ No newline at end of file
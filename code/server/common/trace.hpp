@@ -0,0 +1,258 @@
+#pragma once
+#include <fmt/format.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// 请求级追踪
+// 入口(网关)处理请求时创建追踪 ID，之后随 brpc 请求元数据(log_id，见 channel.hpp)和 MQ 消息头(x-hmy-trace，见 rabbitmq.hpp)
+// 传递到下游，每一跳用 TraceScope 恢复追踪上下文并记录一个 span；存在追踪上下文时 LOG_* 自动在内容前加上 "[trace:追踪ID]"
+// 是否采样只由追踪 ID 决定，各跳不需要传递采样标志也能得到一致的结果；被采样的 span 耗时以 JSON 行写入本地文件
+namespace hmy{
+struct TraceContext
+{
+    uint64_t trace_id = 0; // 0 表示当前没有追踪上下文
+    uint64_t span_id = 0;
+};
+
+class Trace
+{
+public:
+    // create 为 false 且当前执行流还没有上下文时返回 nullptr
+    using Storage = TraceContext* (*)(bool create);
+
+    // 当前执行流的追踪上下文(只读)，默认存放在线程局部存储中，brpc 服务中由 channel.hpp 换成 bthread 局部存储
+    // 每条 LOG_* 都会调用：进程中还没有进入过追踪作用域时不查找存储，没有上下文时返回静态的空上下文，不分配内存
+    static const TraceContext& current()
+    {
+        static const TraceContext empty;
+        if(!enabled().load(std::memory_order_relaxed))
+            return empty;
+        TraceContext* ctx = storage().load(std::memory_order_relaxed)(false);
+        return ctx ? *ctx : empty;
+    }
+
+    // 可写的当前上下文，不存在时创建，供 TraceScope 进入/退出 span 时使用
+    static TraceContext& mutableCurrent()
+    {
+        enable();
+        return *storage().load(std::memory_order_relaxed)(true);
+    }
+
+    // 标记进程已开始使用追踪，之后 current() 才会查找存储
+    static void enable()
+    {
+        if(!enabled().load(std::memory_order_relaxed))
+            enabled().store(true, std::memory_order_relaxed);
+    }
+
+    // 只应在程序启动时(静态初始化阶段)替换，替换前已写入的上下文不会迁移
+    static void setStorage(Storage get)
+    {
+        storage().store(get);
+    }
+
+    // 生成非 0 的随机 ID
+    static uint64_t newId()
+    {
+        thread_local std::mt19937_64 engine(std::random_device{}() ^ ((uint64_t)syscall(SYS_gettid) << 32));
+        uint64_t id;
+        do
+        {
+            id = engine();
+        } while(id == 0);
+        return id;
+    }
+
+    static int64_t nowUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static std::string toHex(uint64_t id)
+    {
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016lx", (unsigned long)id);
+        return buf;
+    }
+
+    // 解析失败返回 0
+    static uint64_t fromHex(std::string_view hex)
+    {
+        if(hex.empty() || hex.size() > 16)
+            return 0;
+        uint64_t id = 0;
+        for(char c : hex)
+        {
+            int v;
+            if(c >= '0' && c <= '9')
+                v = c - '0';
+            else if(c >= 'a' && c <= 'f')
+                v = c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F')
+                v = c - 'A' + 10;
+            else
+                return 0;
+            id = (id << 4) | v;
+        }
+        return id;
+    }
+private:
+    static TraceContext* threadContext(bool /*create*/)
+    {
+        thread_local TraceContext ctx;
+        return &ctx;
+    }
+    static std::atomic<bool>& enabled()
+    {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+    static std::atomic<Storage>& storage()
+    {
+        static std::atomic<Storage> get(&Trace::threadContext);
+        return get;
+    }
+};
+
+// 被采样 span 的导出，每行一个 JSON 对象：
+// {"trace":"追踪ID","span":"spanID","parent":"父spanID","name":"名称","start_us":开始时间,"dur_us":耗时,"tid":线程ID}
+// 写入先进入 stdio 缓冲，后台线程定期刷盘
+class TraceExporter
+{
+public:
+    using ptr = std::shared_ptr<TraceExporter>;
+    // sample_rate 为采样比例 [0, 1]
+    TraceExporter(const std::string& file, double sample_rate, int flush_interval_ms = 1000)
+    : _threshold(sample_rate >= 1 ? UINT64_MAX : (uint64_t)(std::max(sample_rate, 0.0) * (double)UINT64_MAX))
+    , _flush_interval(flush_interval_ms)
+    , _stop(false)
+    {
+        _file = fopen(file.c_str(), "a");
+        if(_file == nullptr)
+        {
+            std::cerr << "打开追踪导出文件 " << file << " 失败: " << strerror(errno) << std::endl;
+            return;
+        }
+        _flusher = std::thread(&TraceExporter::flushLoop, this);
+    }
+
+    ~TraceExporter()
+    {
+        {
+            std::unique_lock lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        if(_flusher.joinable())
+            _flusher.join();
+        if(_file)
+            fclose(_file);
+    }
+
+    // 追踪 ID 本身是随机数，再混合一次避免与调用方自定义的 ID 规律相关
+    bool sampled(uint64_t trace_id) const
+    {
+        if(_file == nullptr || _threshold == 0 || trace_id == 0)
+            return false;
+        uint64_t h = trace_id * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 32;
+        return h <= _threshold;
+    }
+
+    void record(uint64_t trace_id, uint64_t span_id, uint64_t parent_id, std::string_view name, int64_t start_us, int64_t duration_us)
+    {
+        std::string line = fmt::format("{{\"trace\":\"{:016x}\",\"span\":\"{:016x}\",\"parent\":\"{:016x}\",\"name\":\"{}\",\"start_us\":{},\"dur_us\":{},\"tid\":{}}}\n",
+            trace_id, span_id, parent_id, name, start_us, duration_us, (long)syscall(SYS_gettid));
+        std::unique_lock lock(_mutex);
+        fwrite(line.data(), 1, line.size(), _file);
+    }
+private:
+    void flushLoop()
+    {
+        std::unique_lock lock(_mutex);
+        while(!_stop)
+        {
+            _cond.wait_for(lock, _flush_interval);
+            fflush(_file);
+        }
+    }
+
+private:
+    uint64_t _threshold; // 混合后的追踪 ID 不大于该值时采样
+    std::chrono::milliseconds _flush_interval;
+    FILE* _file;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _stop;
+    std::thread _flusher;
+};
+
+TraceExporter::ptr g_trace_exporter;
+// 开启 span 导出，未开启时追踪 ID 仍会传递并出现在日志中
+void init_trace(const std::string& file, double sample_rate)
+{
+    g_trace_exporter = std::make_shared<TraceExporter>(file, sample_rate);
+    Trace::enable();
+}
+
+// 追踪作用域：构造时进入一个新的 span，析构时记录耗时(被采样时)并恢复之前的上下文
+// trace_id 非 0 时加入上游传来的追踪，否则沿用当前追踪，当前也没有时开启新的追踪
+// parent_id 为上游的 span ID，不知道时为 0
+class TraceScope
+{
+public:
+    TraceScope(std::string_view name, uint64_t trace_id = 0, uint64_t parent_id = 0)
+    : _saved(Trace::mutableCurrent())
+    {
+        TraceContext& ctx = Trace::mutableCurrent();
+        if(trace_id != 0 && trace_id != ctx.trace_id)
+        {
+            ctx.trace_id = trace_id;
+            _parent = parent_id;
+        }
+        else
+        {
+            if(ctx.trace_id == 0)
+                ctx.trace_id = Trace::newId();
+            _parent = ctx.span_id;
+        }
+        ctx.span_id = Trace::newId();
+        _sampled = g_trace_exporter && g_trace_exporter->sampled(ctx.trace_id);
+        if(_sampled)
+        {
+            _name = name;
+            _start = Trace::nowUs();
+        }
+    }
+
+    ~TraceScope()
+    {
+        TraceContext& ctx = Trace::mutableCurrent();
+        if(_sampled)
+            g_trace_exporter->record(ctx.trace_id, ctx.span_id, _parent, _name, _start, Trace::nowUs() - _start);
+        ctx = _saved;
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+private:
+    TraceContext _saved;
+    uint64_t _parent;
+    bool _sampled;
+    std::string _name;
+    int64_t _start = 0;
+};
+}
@@ -0,0 +1,20 @@
+// 二进制日志解码工具：把 HMY_LOG_BINARY 模式下写出的日志文件还原为文本输出到标准输出
+// 用法: binlog_decode 日志文件...
+#include "../common/binlog.hpp"
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        std::cerr << "用法: " << argv[0] << " 日志文件..." << std::endl;
+        return 1;
+    }
+    int ret = 0;
+    for(int i = 1; i < argc; ++i)
+    {
+        hmy::BinLogDecoder decoder;
+        if(decoder.decode(argv[i], std::cout) == false)
+            ret = 1;
+    }
+    return ret;
+}